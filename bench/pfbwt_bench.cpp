@@ -0,0 +1,395 @@
+/* Author: Taher Mun
+ * benchmarks for the phases of pfbwt-f64 on synthetic inputs of several
+ * sizes and repetitiveness levels. Each input is a random reference plus
+ * haplotypes that differ from it by SNPs at a given rate, generated from a
+ * fixed seed so that runs are reproducible. Results are written as one JSON
+ * object per line (benchmark, input, timing stats and peak RSS).
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <getopt.h>
+#include "pfbwt.hpp"
+#include "bwt_stream.hpp"
+#include "pfparser.hpp"
+#include "hash.hpp"
+#include "file_wrappers.hpp"
+#include "pfbwt_io.hpp"
+#include "metrics.hpp"
+extern "C" {
+#include "utils.h"
+}
+
+struct Args {
+    std::vector<double> sizes = {1, 8}; // Mbp, all haplotypes together
+    std::vector<double> mut_rates = {0.001, 0.01, 0.1};
+    size_t haplotypes = 8;
+    size_t reps = 3;
+    size_t w = 10;
+    size_t p = 100;
+    int sa = 0;
+    uint64_t seed = 42;
+    std::string tmp = ".";
+    std::string output = "-";
+    std::string benches = "";
+};
+
+/* one synthetic input */
+struct BenchCase {
+    size_t size;
+    size_t haplotypes;
+    double mut_rate;
+    std::string prefix; // input is <prefix>.fa, parse files are <prefix>.<ext>
+};
+
+/* timings of one benchmark on one case */
+struct BenchResult {
+    BenchResult(std::string b, std::string v) : bench(b), variant(v) {}
+    std::string bench;
+    std::string variant;
+    std::vector<double> secs;
+    uint64_t peak_rss = 0;
+};
+
+void print_help() {
+    fprintf(stderr,
+"pfbwt_bench. benchmarks parsing, parse BWT and final BWT on synthetic inputs\n\
+\n\
+usage\n\
+    ./pfbwt_bench [options]\n\
+\n\
+benchmarks\n\
+    add_fasta           PfParser::add_fasta, per hasher\n\
+    sort_dict           PfParser::sort_dict\n\
+    bwt_of_parse        PfParser::bwt_of_parse, incl. writing the workspace\n\
+    sort_dict_suffixes  gSA/gLCP of the dict, in Vec and MMap modes\n\
+    generate_bwt_lcp    final BWT incl. sort_dict_suffixes, in Vec and MMap modes\n\
+    generate_bwt_runs   final BWT delivered as runs, and pulled w/ BWTRunReader\n\
+\n\
+options\n\
+    -s <list>           comma separated input sizes in Mbp [default: 1,8]\n\
+    \n\
+    -d <list>           comma separated SNP rates (lower is more repetitive)\n\
+                        [default: 0.001,0.01,0.1]\n\
+    \n\
+    -H <int>            haplotypes per input [default: 8]\n\
+    \n\
+    -n <int>            repetitions per benchmark [default: 3]\n\
+    \n\
+    -w <int>            window-size for parsing [default: 10]\n\
+    \n\
+    -p <int>            modulo for parsing [default: 100]\n\
+    \n\
+    -b <list>           only run these benchmarks (comma separated)\n\
+    \n\
+    --sa                also build the SA\n\
+    \n\
+    --seed <int>        seed for the synthetic inputs [default: 42]\n\
+    \n\
+    -t <dir>            directory for inputs and workspace files [default: .]\n\
+    \n\
+    -o <file>           write results to <file> [default: stdout]\n\
+    \n\
+    -h                  print this help message\n\
+");
+}
+
+std::vector<std::string> split_list(const char* s) {
+    std::vector<std::string> v;
+    std::string x(s);
+    size_t b = 0, e;
+    while ((e = x.find(',', b)) != std::string::npos) {
+        v.push_back(x.substr(b, e - b));
+        b = e + 1;
+    }
+    v.push_back(x.substr(b));
+    return v;
+}
+
+std::vector<double> parse_list(const char* s) {
+    std::vector<double> v;
+    for (auto& x: split_list(s)) v.push_back(atof(x.data()));
+    return v;
+}
+
+Args parse_args(int argc, char** argv) {
+    Args args;
+    int c;
+    static struct option lopts[] = {
+        {"sa", no_argument, &args.sa, 1},
+        {"seed", required_argument, NULL, 'S'},
+        {"output", required_argument, NULL, 'o'},
+        {0, 0, 0, 0}
+    };
+    while ((c = getopt_long( argc, argv, "s:d:H:n:w:p:b:t:o:h", lopts, NULL) ) != -1) {
+        switch(c) {
+            case 's':
+                args.sizes = parse_list(optarg); break;
+            case 'd':
+                args.mut_rates = parse_list(optarg); break;
+            case 'H':
+                args.haplotypes = atol(optarg); break;
+            case 'n':
+                args.reps = atol(optarg); break;
+            case 'w':
+                args.w = atol(optarg); break;
+            case 'p':
+                args.p = atol(optarg); break;
+            case 'b':
+                args.benches = optarg; break;
+            case 'S':
+                args.seed = strtoull(optarg, NULL, 10); break;
+            case 't':
+                args.tmp = optarg; break;
+            case 'o':
+                args.output = optarg; break;
+            case 'h':
+                print_help(); exit(0);
+            case '?':
+                fprintf(stderr, "Unknown option. Use -h for help.\n");
+                exit(1);
+        }
+    }
+    if (!args.reps || !args.haplotypes) die("-n and -H must be > 0");
+    return args;
+}
+
+bool bench_enabled(const Args& args, std::string name) {
+    if (args.benches == "") return true;
+    auto v = split_list(args.benches.data());
+    return std::find(v.begin(), v.end(), name) != v.end();
+}
+
+/* writes a reference of size/haplotypes random bases, followed by
+ * haplotypes-1 copies of it w/ SNPs at rate mut_rate, to c.prefix.fa
+ */
+void generate_input(const BenchCase& c, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    size_t len = c.size / c.haplotypes;
+    std::vector<char> ref(len);
+    for (auto& x: ref) x = "ACGT"[rng() & 3];
+    std::FILE* fp = fopen((c.prefix + ".fa").data(), "w");
+    if (fp == NULL) die("could not write benchmark input");
+    std::vector<char> hap;
+    for (size_t h = 0; h < c.haplotypes; ++h) {
+        hap = ref;
+        if (h && c.mut_rate > 0) {
+            // skip to the next SNP instead of drawing for every base
+            std::geometric_distribution<size_t> skip(std::min(c.mut_rate, 1.0));
+            for (size_t i = skip(rng); i < len; i += skip(rng) + 1) {
+                hap[i] = "ACGT"[(seq_nt4_table[static_cast<uint8_t>(ref[i])] + 1 + rng() % 3) & 3];
+            }
+        }
+        fprintf(fp, ">hap%zu\n", h);
+        for (size_t i = 0; i < len; i += 60) {
+            fwrite(hap.data() + i, 1, std::min<size_t>(60, len - i), fp);
+            fputc('\n', fp);
+        }
+    }
+    fclose(fp);
+}
+
+void remove_case_files(const BenchCase& c) {
+    for (const char* ext: {"fa", EXTDICT, EXTOCC, "n", EXTPARSE, EXTBWLST, EXTILIST,
+                           EXTBWSAI, EXTGSA, EXTGLCP}) {
+        remove((c.prefix + "." + ext).data());
+    }
+}
+
+/* runs fn as metrics phase name and returns that phase */
+template<typename Fn>
+pfbwtf::Metrics::Phase run_phase(std::string name, Fn fn) {
+    size_t id;
+    {
+        pfbwtf::MetricsPhase ph(name);
+        id = ph.id;
+        fn();
+    }
+    return pfbwtf::metrics().get_phases()[id];
+}
+
+/* the last phase called name, eg. one recorded inside the code being benchmarked */
+const pfbwtf::Metrics::Phase& last_phase(std::string name) {
+    const auto& phases = pfbwtf::metrics().get_phases();
+    for (size_t i = phases.size(); i > 0; --i) {
+        if (phases[i-1].name == name) return phases[i-1];
+    }
+    die("benchmark phase not recorded");
+    return phases[0];
+}
+
+void add_time(BenchResult& r, const pfbwtf::Metrics::Phase& ph) {
+    r.secs.push_back(ph.end.wall - ph.start.wall);
+    r.peak_rss = std::max(r.peak_rss, ph.peak_rss);
+}
+
+void print_result(std::FILE* fp, const Args& args, const BenchCase& c, const BenchResult& r) {
+    std::vector<double> s(r.secs);
+    std::sort(s.begin(), s.end());
+    double mean = 0;
+    for (auto x: s) mean += x;
+    mean /= s.size();
+    double median = s.size() % 2 ? s[s.size()/2] : (s[s.size()/2-1] + s[s.size()/2]) / 2;
+    fprintf(fp, "{\"bench\": \"%s\", \"variant\": \"%s\", \"size\": %zu, \"haplotypes\": %zu, "
+                "\"mut_rate\": %g, \"w\": %zu, \"p\": %zu, \"sa\": %d, \"reps\": %zu, "
+                "\"min_s\": %.6f, \"median_s\": %.6f, \"mean_s\": %.6f, \"max_s\": %.6f, "
+                "\"mbp_per_s\": %.3f, \"peak_rss\": %" PRIu64 "}\n",
+            r.bench.data(), r.variant.data(), c.size, c.haplotypes,
+            c.mut_rate, args.w, args.p, args.sa, s.size(),
+            s.front(), median, mean, s.back(),
+            median > 0 ? c.size / 1e6 / median : 0, r.peak_rss);
+    fflush(fp);
+    fprintf(stderr, "%-20s%-10s%10.3fs (median of %zu)\n", r.bench.data(), r.variant.data(), median, s.size());
+}
+
+pfbwtf::PfParserParams parser_params(const Args& args) {
+    pfbwtf::PfParserParams p;
+    p.w = args.w;
+    p.p = args.p;
+    p.get_sai = args.sa;
+    return p;
+}
+
+template<typename Hasher>
+void bench_add_fasta(const Args& args, const BenchCase& c, std::string hasher, std::FILE* out) {
+    BenchResult r{"add_fasta", hasher};
+    for (size_t i = 0; i < args.reps; ++i) {
+        pfbwtf::PfParser<Hasher> p(parser_params(args));
+        add_time(r, run_phase("add_fasta", [&]() { p.add_fasta(c.prefix + ".fa"); }));
+    }
+    print_result(out, args, c, r);
+}
+
+template<template<typename, typename...> typename R,
+         template<typename, typename...> typename W,
+         template<typename, typename...> typename D
+         >
+void bench_generate_bwt(const Args& args, const BenchCase& c, std::string mode, std::FILE* out) {
+    BenchResult sort{"sort_dict_suffixes", mode};
+    BenchResult gen{"generate_bwt_lcp", mode};
+    pfbwtf::PrefixFreeBWTParams params;
+    params.prefix = c.prefix;
+    params.w = args.w;
+    params.sa = args.sa;
+    for (size_t i = 0; i < args.reps; ++i) {
+        pfbwtf::PrefixFreeBWT<R,W,D> p(params);
+        uint64_t r = 0, sa_sum = 0;
+        auto out_fn = [&](const pfbwtf::out_fn_arg a) {
+            if (a.bwtc != a.pbwtc) ++r;
+            sa_sum += a.sa;
+        };
+        add_time(gen, run_phase("generate_bwt_lcp", [&]() { p.generate_bwt_lcp(out_fn); }));
+        add_time(sort, last_phase("sort_dict_suffixes"));
+        if (!i) fprintf(stderr, "r: %" PRIu64 "\n", r);
+        if (args.sa && !sa_sum) die("no SA was generated");
+    }
+    if (bench_enabled(args, sort.bench)) print_result(out, args, c, sort);
+    if (bench_enabled(args, gen.bench)) print_result(out, args, c, gen);
+}
+
+/* the batched and pull APIs, checked against the per-row callback */
+void bench_bwt_runs(const Args& args, const BenchCase& c, std::FILE* out) {
+    BenchResult runs{"generate_bwt_runs", "callback"};
+    BenchResult pull{"generate_bwt_runs", "BWTRunReader"};
+    pfbwtf::PrefixFreeBWTParams params;
+    params.prefix = c.prefix;
+    params.w = args.w;
+    params.sa = args.sa;
+    typedef pfbwtf::PrefixFreeBWT<VecFileSource, VecFileSinkPrivate, VecFileSinkPrivate> PFBWT;
+    uint64_t r = 0, sa_sum = 0;
+    {
+        PFBWT p(params);
+        p.generate_bwt_lcp([&](const pfbwtf::out_fn_arg a) {
+            if (a.bwtc != a.pbwtc) ++r;
+            sa_sum += a.sa;
+        });
+    }
+    // runs split at max_run, so count char changes rather than runs
+    auto check = [&](uint64_t rr, uint64_t ss, uint64_t rows) {
+        if (rr != r || ss != sa_sum || !rows) die("BWT runs differ from the per-row BWT");
+    };
+    for (size_t i = 0; i < args.reps; ++i) {
+        PFBWT p(params);
+        uint64_t rr = 0, ss = 0, rows = 0;
+        uint8_t prev = 0;
+        auto run_fn = [&](const pfbwtf::BWTRun& run) {
+            if (run.pos != rows) die("BWT runs are not contiguous");
+            if (run.c != prev) ++rr;
+            prev = run.c;
+            rows = run.pos + run.count;
+            if (run.sa) for (uint64_t k = 0; k < run.count; ++k) ss += run.sa[k];
+        };
+        add_time(runs, run_phase("generate_bwt_runs", [&]() { p.generate_bwt_runs(run_fn); }));
+        check(rr, ss, rows);
+    }
+    for (size_t i = 0; i < args.reps; ++i) {
+        PFBWT p(params);
+        uint64_t rr = 0, ss = 0, rows = 0;
+        uint8_t prev = 0;
+        add_time(pull, run_phase("BWTRunReader", [&]() {
+            pfbwtf::BWTRunReader<PFBWT> rd(p);
+            pfbwtf::BWTRun run;
+            while (rd.next(run)) {
+                if (run.pos != rows) die("BWT runs are not contiguous");
+                if (run.c != prev) ++rr;
+                prev = run.c;
+                rows = run.pos + run.count;
+                if (run.sa) for (uint64_t k = 0; k < run.count; ++k) ss += run.sa[k];
+            }
+        }));
+        check(rr, ss, rows);
+    }
+    print_result(out, args, c, runs);
+    print_result(out, args, c, pull);
+}
+
+void run_case(const Args& args, const BenchCase& c, std::FILE* out) {
+    fprintf(stderr, "==== size %zu, %zu haplotypes, SNP rate %g\n", c.size, c.haplotypes, c.mut_rate);
+    if (bench_enabled(args, "add_fasta")) {
+        bench_add_fasta<WangHash>(args, c, "WangHash", out);
+    }
+    // the rest of the benchmarks run on the same parse
+    pfbwtf::PfParser<> p(pfbwtf::parse_from_fasta(c.prefix + ".fa", parser_params(args)));
+    fprintf(stderr, "parse: %zu words, %zu phrases\n", p.get_parse_size(), p.get_sorted_phrases().size());
+    if (bench_enabled(args, "sort_dict")) {
+        BenchResult r{"sort_dict", ""};
+        for (size_t i = 0; i < args.reps; ++i) {
+            add_time(r, run_phase("sort_dict", [&]() { p.sort_dict(); }));
+        }
+        print_result(out, args, c, r);
+    }
+    pfbwtf::save_parser(p, c.prefix);
+    BenchResult r{"bwt_of_parse", ""};
+    for (size_t i = 0; i < args.reps; ++i) {
+        add_time(r, run_phase("bwt_of_parse", [&]() { pfbwtf::save_parse_bwt(p, c.prefix, args.sa); }));
+    }
+    if (bench_enabled(args, r.bench)) print_result(out, args, c, r);
+    if (bench_enabled(args, "sort_dict_suffixes") || bench_enabled(args, "generate_bwt_lcp")) {
+        bench_generate_bwt<VecFileSource, VecFileSinkPrivate, VecFileSinkPrivate>(args, c, "Vec", out);
+        bench_generate_bwt<MMapFileSource, MMapFileSink, MMapFileSinkPrivate>(args, c, "MMap", out);
+    }
+    if (bench_enabled(args, "generate_bwt_runs")) bench_bwt_runs(args, c, out);
+}
+
+int main(int argc, char** argv) {
+    Args args(parse_args(argc, argv));
+    std::FILE* out = args.output == "-" ? stdout : fopen(args.output.data(), "w");
+    if (out == NULL) die("could not open output");
+    // phases are only collected (not written) here; they hold the timings
+    pfbwtf::metrics().open(args.tmp + "/pfbwt_bench.metrics.json", "pfbwt_bench");
+    for (double size: args.sizes) {
+        for (double mut_rate: args.mut_rates) {
+            BenchCase c{static_cast<size_t>(size * 1e6), args.haplotypes, mut_rate, args.tmp + "/pfbwt_bench"};
+            if (c.size < c.haplotypes * (args.w + 1)) die("input size too small for -H and -w");
+            generate_input(c, args.seed);
+            run_case(args, c, out);
+            remove_case_files(c);
+        }
+    }
+    if (out != stdout) fclose(out);
+    return 0;
+}
@@ -0,0 +1,131 @@
+#ifndef BWT_STREAM_HPP
+#define BWT_STREAM_HPP
+
+/* Author: Taher Mun
+ * pull-based access to the BWT of a PrefixFreeBWT, for library users that
+ * consume it directly (e.g. an FM-index builder) instead of reading files.
+ * generate_bwt_runs runs in a background thread and hands over batches of
+ * runs; while one batch is read the next is being filled:
+ *     pfbwtf::BWTRunReader<decltype(p)> rd(p);
+ *     pfbwtf::BWTRun run;
+ *     while (rd.next(run)) ...
+ * run.sa and run.lcp stay valid until the next call to next(). Destroying
+ * the reader before the end stops the producer at its next run.
+ */
+
+#include <cinttypes>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "pfbwt.hpp"
+
+namespace pfbwtf {
+
+template<typename PFBWT>
+class BWTRunReader {
+
+    public:
+
+    /* batch_rows: rows per batch (two batches are in flight), max_run: as
+     * in generate_bwt_runs */
+    BWTRunReader(PFBWT& p, size_t batch_rows = 1 << 20, size_t max_run = 1 << 16) :
+        batch_rows_(batch_rows)
+    {
+        producer_ = std::thread([this, &p, max_run]() {
+            try {
+                p.generate_bwt_runs([this](const BWTRun& run) { add(run); }, max_run);
+                hand_off();
+            } catch (const Stopped&) {}
+            std::lock_guard<std::mutex> lk(m_);
+            done_ = true;
+            cv_.notify_all();
+        });
+    }
+
+    ~BWTRunReader() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        producer_.join();
+    }
+
+    BWTRunReader(const BWTRunReader&) = delete;
+    BWTRunReader& operator=(const BWTRunReader&) = delete;
+
+    /* the next run, or false at the end of the BWT */
+    bool next(BWTRun& run) {
+        if (next_ == read_.runs.size()) {
+            std::unique_lock<std::mutex> lk(m_);
+            cv_.wait(lk, [&]{ return ready_ || done_; });
+            if (!ready_) return false;
+            std::swap(read_, full_);
+            ready_ = false;
+            cv_.notify_all();
+            next_ = 0;
+        }
+        run = read_.runs[next_++];
+        size_t off = run.pos - read_.runs[0].pos;
+        run.sa = run.sa ? read_.sa.data() + off : NULL;
+        run.lcp = run.lcp ? read_.lcp.data() + off : NULL;
+        return true;
+    }
+
+    private:
+
+    struct Stopped {};
+
+    /* runs w/ their SA values and LCPs concatenated. the span pointers of
+     * the stored runs only mark whether they are present */
+    struct Batch {
+        std::vector<BWTRun> runs;
+        std::vector<uint_t> sa;
+        std::vector<uint_t> lcp;
+        size_t rows = 0;
+
+        void clear() {
+            runs.clear();
+            sa.clear();
+            lcp.clear();
+            rows = 0;
+        }
+    };
+
+    void add(const BWTRun& run) {
+        if (stop_) throw Stopped();
+        fill_.runs.push_back(run);
+        if (run.sa) fill_.sa.insert(fill_.sa.end(), run.sa, run.sa + run.count);
+        if (run.lcp) fill_.lcp.insert(fill_.lcp.end(), run.lcp, run.lcp + run.count);
+        fill_.rows += run.count;
+        if (fill_.rows >= batch_rows_) hand_off();
+    }
+
+    /* passes the filled batch to the reader, once it took the previous one */
+    void hand_off() {
+        if (!fill_.rows) return;
+        std::unique_lock<std::mutex> lk(m_);
+        cv_.wait(lk, [&]{ return !ready_ || stop_; });
+        if (stop_) throw Stopped();
+        std::swap(fill_, full_);
+        ready_ = true;
+        lk.unlock();
+        cv_.notify_all();
+        fill_.clear();
+    }
+
+    size_t batch_rows_;
+    Batch fill_, full_, read_; // producer's, handed over, reader's
+    size_t next_ = 0; // in read_.runs
+    std::thread producer_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool ready_ = false; // full_ holds a batch
+    bool done_ = false;
+    std::atomic<bool> stop_{false};
+};
+
+}; // namespace end
+#endif
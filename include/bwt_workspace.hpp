@@ -0,0 +1,251 @@
+#ifndef BWT_WORKSPACE_HPP
+#define BWT_WORKSPACE_HPP
+
+/* Author: Taher Mun
+ * alternative on-disk layouts of the parse-BWT workspace (ilist, bwlast and
+ * bwsai) written after bwt_of_parse and read by PrefixFreeBWT
+ */
+
+#include <cstdio>
+#include <cinttypes>
+#include <vector>
+#include <string>
+#include "sdsl/bit_vectors.hpp"
+#include "sdsl_bv_wrappers.hpp"
+extern "C" {
+#include "utils.h"
+}
+
+namespace pfbwtf {
+
+/* one entry of the ilist together with the bwlast char and bwsai value it
+ * points to. Stored in ilist order, so all the data PrefixFreeBWT needs for
+ * a dict word is contiguous instead of being spread across the parse.
+ */
+template<typename UIntType>
+struct __attribute__((packed)) IlistRecord {
+    UIntType j;   // ilist value (position in parse BWT)
+    UIntType sai; // bwsai[j] (0 if SA info was not collected)
+    uint8_t c;    // bwlast[j]
+};
+
+/* interleaves ilist, bwlast and bwsai (permuted into ilist order) into
+ * records and writes them to fname. bwlast and bwsai must already be in ilist
+ * order (see PfParser::bwt_of_parse). bwsai may be empty.
+ */
+template<typename UIntType>
+void ilist_records_to_file(const std::vector<char>& bwlast,
+                           const std::vector<UIntType>& ilist,
+                           const std::vector<UIntType>& bwsai,
+                           std::string fname) {
+    FILE* fp = fopen(fname.data(), "wb");
+    if (fp == NULL) die("unable to open ilist record file");
+    std::vector<IlistRecord<UIntType>> buf;
+    constexpr size_t bufsize = 1 << 16;
+    buf.reserve(bufsize);
+    for (size_t k = 0; k < ilist.size(); ++k) {
+        IlistRecord<UIntType> r;
+        r.j = ilist[k];
+        r.sai = bwsai.size() ? bwsai[k] : 0;
+        r.c = bwlast[k];
+        buf.push_back(r);
+        if (buf.size() == bufsize || k+1 == ilist.size()) {
+            if (fwrite(buf.data(), sizeof(buf[0]), buf.size(), fp) != buf.size())
+                die("could not write ilist records");
+            buf.clear();
+        }
+    }
+    fclose(fp);
+}
+
+/* helpers for reading/writing the compressed workspace files */
+template<typename T>
+void write_raw_vec(const std::vector<T>& v, FILE* fp) {
+    uint64_t s = v.size();
+    if (fwrite(&s, sizeof(s), 1, fp) != 1 ||
+        fwrite(v.data(), sizeof(T), v.size(), fp) != v.size())
+        die("could not write workspace file");
+}
+
+template<typename T>
+void read_raw_vec(std::vector<T>& v, FILE* fp) {
+    uint64_t s = 0;
+    if (fread(&s, sizeof(s), 1, fp) != 1) die("could not read workspace file");
+    v.resize(s);
+    if (fread(v.data(), sizeof(T), s, fp) != s) die("could not read workspace file");
+}
+
+/* ilist where each group (ilist[0], then the occurrences of each dict word)
+ * is delta coded w/ LEB128 varints: the first value of a group is stored as
+ * is, the rest as (delta - 1), since each group is strictly increasing.
+ * A byte pointer per group allows any word's list to be decoded on its own.
+ */
+template<typename UIntType>
+class DeltaIlist {
+
+    public:
+
+    DeltaIlist() = default;
+
+    /* occs are the dict word frequencies, ie. the group sizes after ilist[0] */
+    DeltaIlist(const std::vector<UIntType>& ilist, const std::vector<UIntType>& occs) : n_(ilist.size()) {
+        ptrs_.reserve(occs.size() + 2);
+        size_t k = 0;
+        append_group(ilist, k, 1);
+        for (auto o: occs) append_group(ilist, k, o);
+        ptrs_.push_back(bytes_.size());
+        if (k != ilist.size()) die("DeltaIlist: occs do not add up to ilist size");
+    }
+
+    DeltaIlist(std::string fname) {
+        FILE* fp = fopen(fname.data(), "rb");
+        if (fp == NULL) {
+            fprintf(stderr, "DeltaIlist: error opening %s\n", fname.data());
+            exit(1);
+        }
+        if (fread(&n_, sizeof(n_), 1, fp) != 1) die("could not read ilist file");
+        read_raw_vec(ptrs_, fp);
+        read_raw_vec(bytes_, fp);
+        fclose(fp);
+    }
+
+    void save(std::string fname) const {
+        FILE* fp = fopen(fname.data(), "wb");
+        if (fp == NULL) die("unable to open compressed ilist file");
+        if (fwrite(&n_, sizeof(n_), 1, fp) != 1) die("could not write ilist file");
+        write_raw_vec(ptrs_, fp);
+        write_raw_vec(bytes_, fp);
+        fclose(fp);
+    }
+
+    /* calls fn on each of the cnt values of group g (0: ilist[0], d+1: dict word d) */
+    template<typename Fn>
+    void decode(size_t g, size_t cnt, Fn fn) const {
+        const uint8_t* p = bytes_.data() + ptrs_[g];
+        uint64_t x = 0;
+        for (size_t i = 0; i < cnt; ++i) {
+            uint64_t v = 0;
+            int shift = 0;
+            uint8_t b;
+            do {
+                b = *p++;
+                v |= static_cast<uint64_t>(b & 0x7F) << shift;
+                shift += 7;
+            } while (b & 0x80);
+            x = i ? x + v + 1 : v;
+            fn(static_cast<UIntType>(x));
+        }
+    }
+
+    size_t size() const { return n_; }
+
+    size_t size_in_bytes() const {
+        return bytes_.size() + ptrs_.size() * sizeof(ptrs_[0]);
+    }
+
+    private:
+
+    void append_group(const std::vector<UIntType>& ilist, size_t& k, size_t cnt) {
+        ptrs_.push_back(bytes_.size());
+        for (size_t i = 0; i < cnt; ++i, ++k) {
+            uint64_t v = i ? ilist[k] - ilist[k-1] - 1 : ilist[k];
+            do {
+                uint8_t b = v & 0x7F;
+                v >>= 7;
+                bytes_.push_back(v ? b | 0x80 : b);
+            } while (v);
+        }
+    }
+
+    uint64_t n_ = 0;
+    std::vector<uint64_t> ptrs_;
+    std::vector<uint8_t> bytes_;
+};
+
+/* bwlast w/ 2 bits per A/C/G/T and an exception list (sd_vector + chars)
+ * for everything else, ie. the 0x00 EOS char and Dollars
+ */
+class PackedBwlast {
+
+    public:
+
+    PackedBwlast() = default;
+
+    PackedBwlast(const std::vector<char>& bwlast) : n_(bwlast.size()) {
+        words_.resize((n_ + 31) / 32, 0);
+        for (size_t i = 0; i < n_; ++i) {
+            uint8_t c = bwlast[i];
+            uint8_t x = seq_nt4_table[c];
+            if (x > 3 || "ACGT"[x] != c) {
+                exc_pos_.push_back(i);
+                exc_chars_.push_back(c);
+                x = 0;
+            }
+            words_[i / 32] |= static_cast<uint64_t>(x) << (2 * (i % 32));
+        }
+        init_exc();
+    }
+
+    PackedBwlast(std::string fname) {
+        FILE* fp = fopen(fname.data(), "rb");
+        if (fp == NULL) {
+            fprintf(stderr, "PackedBwlast: error opening %s\n", fname.data());
+            exit(1);
+        }
+        if (fread(&n_, sizeof(n_), 1, fp) != 1) die("could not read bwlast file");
+        read_raw_vec(words_, fp);
+        read_raw_vec(exc_pos_, fp);
+        read_raw_vec(exc_chars_, fp);
+        fclose(fp);
+        init_exc();
+    }
+
+    void save(std::string fname) const {
+        FILE* fp = fopen(fname.data(), "wb");
+        if (fp == NULL) die("unable to open packed bwlast file");
+        if (fwrite(&n_, sizeof(n_), 1, fp) != 1) die("could not write bwlast file");
+        write_raw_vec(words_, fp);
+        write_raw_vec(exc_pos_, fp);
+        write_raw_vec(exc_chars_, fp);
+        fclose(fp);
+    }
+
+    uint8_t operator[](size_t i) const {
+        if (exc_pos_.size() && exc_[i]) return exc_chars_[exc_.rank(i)];
+        return "ACGT"[(words_[i / 32] >> (2 * (i % 32))) & 3];
+    }
+
+    size_t size() const { return n_; }
+
+    private:
+
+    // exc_pos_ is increasing, so the sd_vector is built w/o an n-bit bit_vector
+    void init_exc() {
+        if (!exc_pos_.size()) return;
+        sdsl::sd_vector_builder b(n_, exc_pos_.size());
+        for (size_t k = 0; k < exc_pos_.size(); ++k) {
+            if (k && exc_pos_[k] <= exc_pos_[k-1]) die("packed bwlast exceptions are not increasing");
+            b.set(exc_pos_[k]);
+        }
+        exc_ = bv_rs<sdsl::sd_vector<>>(sdsl::sd_vector<>(b));
+    }
+
+    uint64_t n_ = 0;
+    std::vector<uint64_t> words_;
+    std::vector<uint64_t> exc_pos_;
+    std::vector<uint8_t> exc_chars_;
+    bv_rs<sdsl::sd_vector<>> exc_;
+};
+
+/* writes ilist and bwlast in compressed form (see DeltaIlist, PackedBwlast) */
+template<typename UIntType>
+void compressed_workspace_to_file(const std::vector<char>& bwlast,
+                                  const std::vector<UIntType>& ilist,
+                                  const std::vector<UIntType>& occs,
+                                  std::string prefix) {
+    DeltaIlist<UIntType>(ilist, occs).save(prefix + "." + EXTCILIST);
+    PackedBwlast(bwlast).save(prefix + "." + EXTPBWLST);
+}
+
+}; // namespace end
+#endif
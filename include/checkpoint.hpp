@@ -0,0 +1,99 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+/* Author: Taher Mun
+ * manifests used to checkpoint long pfbwt-f and merge_pfp runs, and to check
+ * that a checkpoint still matches the inputs before resuming from it
+ */
+
+#include <cstdio>
+#include <cinttypes>
+#include <map>
+#include <string>
+#include <unistd.h>
+extern "C" {
+#include "utils.h"
+}
+
+namespace pfbwtf {
+
+/* FNV-1a hash, used to tie a checkpoint to the data it was made from */
+uint64_t fnv1a(const void* data, size_t len, uint64_t h = 14695981039346656037ULL) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/* flushes fp all the way to disk */
+void fsync_file(std::FILE* fp) {
+    if (fflush(fp) || fsync(fileno(fp))) die("could not flush file to disk");
+}
+
+/* key/value manifest. saved atomically (written to a temp file, synced,
+ * then renamed), so a run that dies mid-save leaves the last one intact
+ */
+class Checkpoint {
+
+    public:
+
+    void set(std::string k, uint64_t v) { kv[k] = v; }
+
+    bool has(std::string k) const { return kv.count(k); }
+
+    uint64_t get(std::string k) const {
+        auto it = kv.find(k);
+        if (it == kv.end()) {
+            fprintf(stderr, "checkpoint: missing key %s\n", k.data());
+            exit(1);
+        }
+        return it->second;
+    }
+
+    /* true if every key of expect has the same value here */
+    bool matches(const Checkpoint& expect) const {
+        for (const auto& e: expect.kv) {
+            auto it = kv.find(e.first);
+            if (it == kv.end() || it->second != e.second) {
+                fprintf(stderr, "checkpoint: %s does not match\n", e.first.data());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /* returns false if fname does not exist or is not a checkpoint */
+    bool load(std::string fname) {
+        kv.clear();
+        std::FILE* fp = fopen(fname.data(), "r");
+        if (fp == NULL) return false;
+        char k[256];
+        uint64_t v;
+        bool ok = fscanf(fp, "%255s %" SCNu64, k, &v) == 2 && std::string(k) == magic && v == version;
+        while (ok && fscanf(fp, "%255s %" SCNu64, k, &v) == 2) kv[k] = v;
+        fclose(fp);
+        return ok;
+    }
+
+    void save(std::string fname) const {
+        std::string tmp = fname + ".tmp";
+        std::FILE* fp = fopen(tmp.data(), "w");
+        if (fp == NULL) die("could not write checkpoint");
+        fprintf(fp, "%s %" PRIu64 "\n", magic, version);
+        for (const auto& e: kv) fprintf(fp, "%s %" PRIu64 "\n", e.first.data(), e.second);
+        fsync_file(fp);
+        fclose(fp);
+        if (rename(tmp.data(), fname.data())) die("could not write checkpoint");
+    }
+
+    private:
+
+    static constexpr const char* magic = "pfbwtf-checkpoint";
+    static constexpr uint64_t version = 1;
+    std::map<std::string, uint64_t> kv;
+};
+
+}; // namespace end
+#endif
@@ -0,0 +1,308 @@
+#ifndef DICT_SORT_HPP
+#define DICT_SORT_HPP
+
+/* Author: Taher Mun
+ * alternatives to running gSACAK over the whole dictionary.
+ * Only suffixes of dict words are compared here: every comparison stops at
+ * the EndOfWord that closes the word, so two suffixes compare equal iff they
+ * spell the same string up to their word end. This is exactly the grouping
+ * that generate_bwt_lcp needs.
+ */
+
+#include <cstdio>
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <queue>
+#include "sdsl/bit_vectors.hpp"
+extern "C" {
+#include "utils.h"
+}
+
+namespace pfbwtf {
+
+/* length of dict suffix starting at i, not counting its EndOfWord */
+template<typename Dict>
+inline size_t dict_suffix_len(const Dict& dict, size_t i) {
+    size_t l = 0;
+    while (dict[i+l] != EndOfWord) ++l;
+    return l;
+}
+
+/* compare two dict suffixes starting from depth d.
+ * returns <0, 0, >0 like strcmp, where 0 means the whole suffixes are equal
+ */
+template<typename Dict>
+inline int dict_suffix_cmp(const Dict& dict, size_t a, size_t b, size_t d = 0) {
+    uint8_t ca, cb;
+    for (;; ++d) {
+        ca = dict[a+d];
+        cb = dict[b+d];
+        if (ca != cb) return ca < cb ? -1 : 1;
+        if (ca == EndOfWord) return 0;
+    }
+}
+
+/* number of dict suffixes w/ length > w
+ * (these are the only ones used to build the final BWT)
+ */
+template<typename Dict>
+size_t count_sparse_suffixes(const Dict& dict, size_t dsize, size_t w) {
+    size_t m = 0, l = 0;
+    for (size_t i = dsize; i-- > 0; ) {
+        if (dict[i] == EndOfWord || dict[i] == EndOfDict) {
+            l = 0;
+        } else if (++l > w) {
+            ++m;
+        }
+    }
+    return m;
+}
+
+/* writes (in text order) the start positions of dict suffixes w/ length > w */
+template<typename Dict, typename SA>
+void fill_sparse_suffixes(const Dict& dict, size_t dsize, size_t w, SA& sa) {
+    size_t j = 0;
+    size_t wstart = 0;
+    for (size_t i = 0; i < dsize; ++i) {
+        if (dict[i] == EndOfWord || dict[i] == EndOfDict) {
+            // suffixes of this word with length > w are [wstart, i-w)
+            for (size_t k = wstart; k + w < i; ++k) sa[j++] = k;
+            wstart = i+1;
+        }
+    }
+}
+
+/* multikey quicksort (Bentley & Sedgewick) of the dict suffixes in sa[lo, hi)
+ * all suffixes in the range are assumed to share their first d characters.
+ * same[k] is set to 1 if suffix sa[k] equals suffix sa[k-1], which replaces
+ * the LCP array for grouping purposes. same must be zero-initialized.
+ */
+template<typename Dict, typename SA>
+void dict_mkqs(const Dict& dict, SA& sa, size_t lo, size_t hi, sdsl::bit_vector& same, size_t d = 0) {
+    struct Task { size_t lo, hi, d; };
+    std::vector<Task> stack;
+    stack.push_back({lo, hi, d});
+    while (stack.size()) {
+        Task t = stack.back();
+        stack.pop_back();
+        size_t n = t.hi - t.lo;
+        if (n < 2) continue;
+        if (n < 16) { // insertion sort on small ranges
+            for (size_t i = t.lo + 1; i < t.hi; ++i) {
+                auto x = sa[i];
+                size_t j = i;
+                while (j > t.lo && dict_suffix_cmp(dict, x, sa[j-1], t.d) < 0) {
+                    sa[j] = sa[j-1];
+                    --j;
+                }
+                sa[j] = x;
+            }
+            for (size_t i = t.lo + 1; i < t.hi; ++i) {
+                if (!dict_suffix_cmp(dict, sa[i-1], sa[i], t.d)) same[i] = 1;
+            }
+            continue;
+        }
+        // median of three as pivot
+        uint8_t a = dict[sa[t.lo] + t.d];
+        uint8_t b = dict[sa[t.lo + n/2] + t.d];
+        uint8_t c = dict[sa[t.hi-1] + t.d];
+        uint8_t v = a < b ? (b < c ? b : (a < c ? c : a)) : (a < c ? a : (b < c ? c : b));
+        // 3-way partition: [lo, lt) < v, [lt, gt) == v, [gt, hi) > v
+        size_t lt = t.lo, i = t.lo, gt = t.hi;
+        while (i < gt) {
+            uint8_t x = dict[sa[i] + t.d];
+            if (x < v) {
+                auto tmp = sa[lt]; sa[lt] = sa[i]; sa[i] = tmp;
+                ++lt; ++i;
+            } else if (x > v) {
+                --gt;
+                auto tmp = sa[gt]; sa[gt] = sa[i]; sa[i] = tmp;
+            } else {
+                ++i;
+            }
+        }
+        stack.push_back({t.lo, lt, t.d});
+        stack.push_back({gt, t.hi, t.d});
+        if (v == EndOfWord) { // all suffixes in [lt, gt) end here
+            for (size_t k = lt + 1; k < gt; ++k) same[k] = 1;
+        } else {
+            stack.push_back({lt, gt, t.d+1});
+        }
+    }
+}
+
+/* fills same[k] (see dict_mkqs) for an already sorted sa[start, end) by
+ * comparing neighbouring suffixes up to their word ends. Used in place of
+ * the gLCP when gSACAK is run without it
+ */
+template<typename Dict, typename SA>
+void mark_equal_suffixes(const Dict& dict, const SA& sa, size_t start, size_t end, sdsl::bit_vector& same) {
+    same = sdsl::bit_vector(end, 0);
+    for (size_t k = start + 1; k < end; ++k) {
+        if (!dict_suffix_cmp(dict, sa[k-1], sa[k])) same[k] = 1;
+    }
+}
+
+/* sorts only the dict suffixes with length > w.
+ * sa is resized via init_fn(m) before being filled
+ */
+template<typename Dict, typename SA, typename InitFn>
+size_t sparse_dict_sort(const Dict& dict, size_t dsize, size_t w, SA& sa, sdsl::bit_vector& same, InitFn init_fn) {
+    size_t m = count_sparse_suffixes(dict, dsize, w);
+    init_fn(m);
+    fill_sparse_suffixes(dict, dsize, w, sa);
+    same = sdsl::bit_vector(m, 0);
+    dict_mkqs(dict, sa, 0, m, same);
+    return m;
+}
+
+/* buffered sequential reader over one sorted run written by external_dict_sort */
+template<typename UIntType>
+class DictRunReader {
+
+    public:
+
+    DictRunReader(const char* base, int num, size_t bufsize)
+        : buf_(bufsize)
+    {
+        fp_ = open_aux_file_num(base, "gsa_run", num, "rb");
+        fill();
+    }
+
+    DictRunReader(DictRunReader&& rhs)
+        : fp_(rhs.fp_), buf_(std::move(rhs.buf_)), i_(rhs.i_), n_(rhs.n_)
+    {
+        rhs.fp_ = NULL;
+    }
+
+    ~DictRunReader() { if (fp_ != NULL) fclose(fp_); }
+
+    bool empty() const { return i_ >= n_; }
+
+    UIntType front() const { return buf_[i_]; }
+
+    void pop() {
+        if (++i_ >= n_) fill();
+    }
+
+    private:
+
+    void fill() {
+        n_ = fread(buf_.data(), sizeof(UIntType), buf_.size(), fp_);
+        i_ = 0;
+    }
+
+    FILE* fp_ = NULL;
+    std::vector<UIntType> buf_;
+    size_t i_ = 0;
+    size_t n_ = 0;
+};
+
+#define DICT_RUN_FAN_IN 128
+
+/* k-way merge of the sorted runs <base>.<id>.gsa_run for id in ids.
+ * out_fn is called on each suffix in sorted order. Merged runs are deleted.
+ */
+template<typename UIntType, typename Dict, typename OutFn>
+void merge_dict_runs(const Dict& dict, std::string base, const std::vector<int>& ids, size_t bufsize, OutFn out_fn) {
+    std::vector<DictRunReader<UIntType>> runs;
+    runs.reserve(ids.size());
+    for (auto id: ids) runs.emplace_back(base.data(), id, bufsize);
+    auto cmp = [&](int a, int b) { // min-heap on suffixes, ties by run
+        int c = dict_suffix_cmp(dict, runs[a].front(), runs[b].front());
+        return c ? c > 0 : a > b;
+    };
+    std::priority_queue<int, std::vector<int>, decltype(cmp)> heap(cmp);
+    for (size_t k = 0; k < runs.size(); ++k) if (!runs[k].empty()) heap.push(k);
+    while (heap.size()) {
+        int k = heap.top();
+        heap.pop();
+        out_fn(runs[k].front());
+        runs[k].pop();
+        if (!runs[k].empty()) heap.push(k);
+    }
+    runs.clear();
+    for (auto id: ids) {
+        std::string run_fname = base + "." + std::to_string(id) + ".gsa_run";
+        remove(run_fname.data());
+    }
+}
+
+/* external memory version of sparse_dict_sort, for dicts whose gSA does not
+ * fit in RAM. Suffixes (length > w) are collected in blocks of at most
+ * block_size entries, each block is sorted in RAM and written to
+ * <base>.<k>.gsa_run, then runs are merged in sequential passes
+ * (at most DICT_RUN_FAN_IN at a time), the last of which writes sa.
+ * dict is only read, so it can stay mmapped.
+ */
+template<typename UIntType, typename Dict, typename SA, typename InitFn>
+size_t external_dict_sort(const Dict& dict, size_t dsize, size_t w, SA& sa, sdsl::bit_vector& same,
+                          InitFn init_fn, std::string base, size_t block_size, bool verbose = false) {
+    if (block_size < 1) die("external_dict_sort: block size must be positive");
+    std::vector<UIntType> block;
+    block.reserve(block_size);
+    sdsl::bit_vector block_same;
+    int nruns = 0;
+    size_t m = 0;
+    auto flush_block = [&]() {
+        if (!block.size()) return;
+        block_same = sdsl::bit_vector(block.size(), 0);
+        dict_mkqs(dict, block, 0, block.size(), block_same);
+        FILE* fp = open_aux_file_num(base.data(), "gsa_run", nruns++, "wb");
+        if (fwrite(block.data(), sizeof(UIntType), block.size(), fp) != block.size())
+            die("error writing gsa run");
+        fclose(fp);
+        m += block.size();
+        block.clear();
+    };
+    // sequential scan of the dict, same order as fill_sparse_suffixes
+    size_t wstart = 0;
+    for (size_t i = 0; i < dsize; ++i) {
+        if (dict[i] == EndOfWord || dict[i] == EndOfDict) {
+            for (size_t k = wstart; k + w < i; ++k) {
+                block.push_back(k);
+                if (block.size() == block_size) flush_block();
+            }
+            wstart = i+1;
+        }
+    }
+    flush_block();
+    std::vector<UIntType>().swap(block);
+    block_same = sdsl::bit_vector();
+    if (verbose) fprintf(stderr, "sorted %lu dict suffixes in %d runs\n", m, nruns);
+    size_t bufsize = block_size / (DICT_RUN_FAN_IN + 1) + 1;
+    bufsize = bufsize < 4096 ? 4096 : bufsize;
+    std::vector<int> ids;
+    for (int k = 0; k < nruns; ++k) ids.push_back(k);
+    // intermediate passes, so that no more than DICT_RUN_FAN_IN runs are open at once
+    while (ids.size() > DICT_RUN_FAN_IN) {
+        std::vector<int> next_ids;
+        for (size_t g = 0; g < ids.size(); g += DICT_RUN_FAN_IN) {
+            size_t e = g + DICT_RUN_FAN_IN < ids.size() ? g + DICT_RUN_FAN_IN : ids.size();
+            std::vector<int> group(ids.begin() + g, ids.begin() + e);
+            FILE* fp = open_aux_file_num(base.data(), "gsa_run", nruns, "wb");
+            merge_dict_runs<UIntType>(dict, base, group, bufsize, [&](UIntType x) {
+                if (fwrite(&x, sizeof(x), 1, fp) != 1) die("error writing gsa run");
+            });
+            fclose(fp);
+            next_ids.push_back(nruns++);
+        }
+        ids = next_ids;
+        if (verbose) fprintf(stderr, "merged into %lu runs\n", ids.size());
+    }
+    // final pass writes gSA and marks equal suffixes
+    init_fn(m);
+    same = sdsl::bit_vector(m, 0);
+    size_t j = 0;
+    merge_dict_runs<UIntType>(dict, base, ids, bufsize, [&](UIntType x) {
+        sa[j] = x;
+        if (j && !dict_suffix_cmp(dict, sa[j-1], sa[j])) same[j] = 1;
+        ++j;
+    });
+    if (j != m) die("external_dict_sort: merge lost suffixes");
+    return m;
+}
+
+}; // namespace end
+#endif
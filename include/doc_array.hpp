@@ -0,0 +1,52 @@
+#ifndef DOC_ARRAY_HPP
+#define DOC_ARRAY_HPP
+
+/* Author: Taher Mun
+ * maps text positions to the document (fasta record) they fall in, for the
+ * document array (--da, --rlda). Doc starts, as saved to <prefix>.docs by
+ * --print-docs, are marked in an Elias-Fano sd_vector, so a lookup is one
+ * rank. The w As that pad a record belong to it, and the terminator to the
+ * last record.
+ */
+
+#include <cinttypes>
+#include <vector>
+#include "sdsl/bit_vectors.hpp"
+#include "sdsl_bv_wrappers.hpp"
+extern "C" {
+#include "utils.h"
+}
+
+namespace pfbwtf {
+
+class DocStarts {
+
+    public:
+
+    DocStarts() = default;
+
+    /* starts must be increasing, start at 0 and be < n */
+    template<typename U>
+    DocStarts(const std::vector<U>& starts, uint64_t n) {
+        if (!starts.size() || starts[0]) die("doc starts must include text position 0");
+        sdsl::sd_vector_builder b(n, starts.size());
+        for (size_t k = 0; k < starts.size(); ++k) {
+            if (k && starts[k] <= starts[k-1]) die("doc starts are not increasing");
+            b.set(starts[k]);
+        }
+        marks_ = bv_rs<sdsl::sd_vector<>>(sdsl::sd_vector<>(b));
+        ndocs_ = starts.size();
+    }
+
+    uint64_t operator()(uint64_t pos) const { return marks_.rank(pos + 1) - 1; }
+
+    size_t size() const { return ndocs_; }
+
+    private:
+
+    bv_rs<sdsl::sd_vector<>> marks_;
+    size_t ndocs_ = 0;
+};
+
+}; // namespace end
+#endif
@@ -2,10 +2,15 @@
 #define FILEW_HPP
 
 #include <vector>
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "mio.hpp"
 
 void die_(const char* string) {
@@ -28,9 +33,59 @@ size_t get_file_size_(const char* path) {
     return size;
 }
 
-/* load file using mmap and treat it as an STL container (mio)
- * TODO: create a MAP_PRIVATE version
+/* how a memory-mapped array is going to be accessed. passed on to the kernel
+ * via madvise/posix_fadvise so that read-ahead matches the access pattern.
+ * WINDOW turns off kernel read-ahead and relies on explicit prefetch() calls
+ * for the ranges that are about to be read.
  */
+enum class MMapAccess { NORMAL, SEQUENTIAL, RANDOM, WINDOW };
+
+struct MMapPolicy {
+    MMapAccess access = MMapAccess::NORMAL;
+    bool populate = false; // fault in all pages up front (like MAP_POPULATE)
+    bool hugepages = false; // ask for transparent huge pages
+    size_t window = 1 << 20; // min. bytes read ahead per prefetch() for WINDOW
+};
+
+/* applies policy p to the page-aligned mapping [start, start+len) of file fd */
+inline void mmap_apply_policy_(void* start, size_t len, int fd, const MMapPolicy& p) {
+    if (start == NULL || !len) return;
+    int madv = MADV_NORMAL, fadv = POSIX_FADV_NORMAL;
+    switch (p.access) {
+        case MMapAccess::SEQUENTIAL:
+            madv = MADV_SEQUENTIAL; fadv = POSIX_FADV_SEQUENTIAL; break;
+        case MMapAccess::RANDOM:
+        case MMapAccess::WINDOW:
+            madv = MADV_RANDOM; fadv = POSIX_FADV_RANDOM; break;
+        default: break;
+    }
+    // hints are best-effort: failures are not fatal
+    madvise(start, len, madv);
+    if (fd >= 0) posix_fadvise(fd, 0, 0, fadv);
+#ifdef MADV_HUGEPAGE
+    if (p.hugepages) madvise(start, len, MADV_HUGEPAGE);
+#endif
+    if (p.populate) {
+#ifdef MADV_POPULATE_READ
+        if (!madvise(start, len, MADV_POPULATE_READ)) return;
+#endif
+        madvise(start, len, MADV_WILLNEED);
+        const size_t pg = sysconf(_SC_PAGESIZE);
+        const volatile char* q = static_cast<const volatile char*>(start);
+        for (size_t i = 0; i < len; i += pg) (void) q[i];
+    }
+}
+
+/* asks the kernel to read [lo, hi) of the mapping that begins at start */
+inline void mmap_willneed_(const void* start, size_t len, size_t lo, size_t hi) {
+    const size_t pg = sysconf(_SC_PAGESIZE);
+    lo -= lo % pg;
+    if (hi > len) hi = len;
+    if (lo >= hi) return;
+    madvise(const_cast<char*>(static_cast<const char*>(start)) + lo, hi - lo, MADV_WILLNEED);
+}
+
+/* load file using mmap and treat it as an STL container (mio) */
 
 template<typename T, mio::access_mode AccessMode>
 class MMapFile {
@@ -48,7 +103,8 @@ class MMapFile {
     MMapFile() = default;
 
     MMapFile(std::string path) :
-        mm(path)
+        mm(path),
+        path_(path)
     {
         if (!mm.size()) {
             die_("MMapFile: file empty!");
@@ -76,6 +132,7 @@ class MMapFile {
         // map file
         std::error_code e;
         mm.map(path, 0, size * sizeof(T), e);
+        path_ = path;
     }
 
     template<mio::access_mode A = AccessMode, typename = typename std::enable_if<A == mio::access_mode::write>::type>
@@ -110,19 +167,202 @@ class MMapFile {
     const_iterator end() const noexcept { return data() + size(); }
     const_iterator cend() const noexcept { return data() + size(); }
 
+    /* sets the access policy for the whole mapping */
+    void advise(MMapPolicy p) {
+        policy = p;
+        pf_lo = pf_hi = 0;
+        mmap_apply_policy_(mapping_start(), mm.mapped_length(), mm.file_handle(), p);
+    }
+
+    /* hints that elements [i, i+n) will be read soon. only does anything
+     * under MMapAccess::WINDOW, where at least policy.window bytes are read
+     * ahead so that nearby ranges don't each cost a system call
+     */
+    void prefetch(size_t i, size_t n) const {
+        if (policy.access != MMapAccess::WINDOW || !n) return;
+        size_t lo = mm.mapping_offset() + i * sizeof(T);
+        size_t hi = lo + n * sizeof(T);
+        if (lo >= pf_lo && hi <= pf_hi) return;
+        pf_lo = lo;
+        pf_hi = std::max(hi, lo + policy.window);
+        mmap_willneed_(mapping_start(), mm.mapped_length(), pf_lo, pf_hi);
+    }
+
+    /* flushes changes to the underlying file */
+    template<mio::access_mode A = AccessMode, typename = typename std::enable_if<A == mio::access_mode::write>::type>
+    void sync() {
+        std::error_code e;
+        mm.sync(e);
+        if (e) die_("error syncing mmap'd file");
+    }
+
+    const std::string& path() const { return path_; }
+
     private:
+
+    void* mapping_start() const {
+        return mm.data() ? const_cast<unsigned char*>(mm.data()) - mm.mapping_offset() : NULL;
+    }
+
     mio::basic_mmap<AccessMode, unsigned char> mm;
-    T* data_; // this is derived from mm
+    std::string path_;
+    MMapPolicy policy;
+    mutable size_t pf_lo = 0, pf_hi = 0; // last prefetched byte range
 };
 
 template<typename T>
 using MMapFileSource = MMapFile<T, mio::access_mode::read>;
 
-/* NOTE: I think this is MAP_SHARED by default.
- * TODO: add option for MAP_PRIVATE */
+/* NOTE: mio maps w/ MAP_SHARED, so changes are written back to the file */
 template<typename T>
 using MMapFileSink = MMapFile<T, mio::access_mode::write>;
 
+/* writable, copy-on-write (MAP_PRIVATE) mapping of a file: changes are never
+ * written back, as with VecFileSinkPrivate, but pages are only read in when
+ * touched. mio has no MAP_PRIVATE mode, so this calls mmap directly.
+ */
+template<typename T>
+class MMapFileSinkPrivate {
+
+    public:
+
+    using value_type = T;
+    using size_type = size_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+    using iterator = value_type*;
+    using const_iterator = const value_type*;
+
+    MMapFileSinkPrivate() = default;
+
+    MMapFileSinkPrivate(std::string path) {
+        map_(path, false, 0);
+        if (!size()) {
+            die_("MMapFileSinkPrivate: file empty!");
+        }
+        if (len_ % sizeof(T) != 0) {
+            die_("error: file is not evenly divided into size(T)-sized words");
+        }
+    }
+
+    MMapFileSinkPrivate(const MMapFileSinkPrivate&) = delete;
+    MMapFileSinkPrivate& operator=(const MMapFileSinkPrivate&) = delete;
+
+    MMapFileSinkPrivate(MMapFileSinkPrivate&& o) noexcept { swap_(o); }
+
+    MMapFileSinkPrivate& operator=(MMapFileSinkPrivate&& o) noexcept {
+        if (this != &o) {
+            unmap_();
+            swap_(o);
+        }
+        return *this;
+    }
+
+    ~MMapFileSinkPrivate() { unmap_(); }
+
+    /* start fresh from a file, given a size (number of elements) */
+    void init_file(std::string path, size_t size) {
+        unmap_();
+        map_(path, true, size * sizeof(T));
+    }
+
+    reference operator[](const size_type i) noexcept { return data_[i]; }
+    const_reference operator[](const size_type i) const noexcept { return data_[i]; }
+
+    size_t size() const noexcept { return len_ / sizeof(T); }
+
+    T* data() noexcept { return data_; }
+    const T* data() const noexcept { return data_; }
+
+    iterator begin() noexcept { return data(); }
+    const_iterator begin() const noexcept { return data(); }
+    const_iterator cbegin() const noexcept { return data(); }
+
+    iterator end() noexcept { return data() + size(); }
+    const_iterator end() const noexcept { return data() + size(); }
+    const_iterator cend() const noexcept { return data() + size(); }
+
+    void advise(MMapPolicy p) {
+        policy = p;
+        pf_lo = pf_hi = 0;
+        mmap_apply_policy_(data_, len_, fd_, p);
+    }
+
+    void prefetch(size_t i, size_t n) const {
+        if (policy.access != MMapAccess::WINDOW || !n) return;
+        size_t lo = i * sizeof(T), hi = lo + n * sizeof(T);
+        if (lo >= pf_lo && hi <= pf_hi) return;
+        pf_lo = lo;
+        pf_hi = std::max(hi, lo + policy.window);
+        mmap_willneed_(data_, len_, pf_lo, pf_hi);
+    }
+
+    private:
+
+    void map_(std::string path, bool fresh, size_t bytes) {
+        fd_ = open(path.data(), fresh ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY, 0644);
+        if (fd_ < 0) {
+            fprintf(stderr, "%s: ", path.data());
+            die_("error opening file");
+        }
+        if (fresh) {
+            if (ftruncate(fd_, bytes)) die_("error setting file size");
+        } else {
+            struct stat st;
+            if (fstat(fd_, &st)) die_("error reading file size");
+            bytes = st.st_size;
+        }
+        len_ = bytes;
+        if (!len_) return;
+        void* m = mmap(NULL, len_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd_, 0);
+        if (m == MAP_FAILED) {
+            fprintf(stderr, "%s: ", path.data());
+            die_("error mapping file");
+        }
+        data_ = static_cast<T*>(m);
+    }
+
+    void unmap_() {
+        if (data_) munmap(data_, len_);
+        if (fd_ >= 0) close(fd_);
+        data_ = NULL;
+        len_ = 0;
+        fd_ = -1;
+    }
+
+    void swap_(MMapFileSinkPrivate& o) {
+        std::swap(data_, o.data_);
+        std::swap(len_, o.len_);
+        std::swap(fd_, o.fd_);
+        std::swap(policy, o.policy);
+        std::swap(pf_lo, o.pf_lo);
+        std::swap(pf_hi, o.pf_hi);
+    }
+
+    T* data_ = NULL;
+    size_t len_ = 0;
+    int fd_ = -1;
+    MMapPolicy policy;
+    mutable size_t pf_lo = 0, pf_hi = 0;
+};
+
+/* apply/prefetch for any container: a no-op for containers that live in
+ * memory (VecFile*), forwarded to advise()/prefetch() for mmap'd ones
+ */
+template<typename C>
+auto mmap_advise_(C& c, MMapPolicy p, int) -> decltype(c.advise(p), void()) { c.advise(p); }
+template<typename C>
+void mmap_advise_(C&, MMapPolicy, long) {}
+template<typename C>
+void mmap_advise(C& c, MMapPolicy p) { mmap_advise_(c, p, 0); }
+
+template<typename C>
+auto mmap_prefetch_(const C& c, size_t i, size_t n, int) -> decltype(c.prefetch(i, n), void()) { c.prefetch(i, n); }
+template<typename C>
+void mmap_prefetch_(const C&, size_t, size_t, long) {}
+template<typename C>
+void mmap_prefetch(const C& c, size_t i, size_t n) { mmap_prefetch_(c, i, n, 0); }
+
 /* loads a file into a read-only vector. neither the data nor the underlying
  * file are allowed to be changed */
 template<typename T>
@@ -141,7 +381,7 @@ class VecFileSource : private std::vector<T> {
             exit(1);
         }
         this->resize(nelems);
-        if (fread(&(this->data())[0], sizeof(T), this->size(), fp) != nelems) {
+        if (fread(std::vector<T>::data(), sizeof(T), this->size(), fp) != nelems) {
             fprintf(stderr, "VecFileSource: error reading from %s\n", path.data());
             exit(1);
         }
@@ -155,6 +395,10 @@ class VecFileSource : private std::vector<T> {
     typename std::vector<T>::size_type size() const {
         return std::vector<T>::size();
     }
+
+    const T* data() const {
+        return std::vector<T>::data();
+    }
 };
 
 template<typename T>
@@ -220,4 +464,125 @@ class VecFileSinkShared : public VecFileSink<T> {
 
 template<typename T>
 using VecFileSinkPrivate = VecFileSink<T>;
+
+/* container that is either read into memory (V) or mmap'd (M), decided at
+ * runtime, so that each workspace array can be placed separately
+ * (see workspace_plan.hpp). Elements are accessed through a cached pointer,
+ * so there is no per-access branch.
+ */
+template<typename T, template<typename> typename M, template<typename> typename V>
+class PlacedFile {
+
+    public:
+
+    using value_type = T;
+    using size_type = size_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+
+    PlacedFile() = default;
+
+    PlacedFile(std::string path, bool mapped = false) : mapped_(mapped) {
+        if (mapped_) mm_ = M<T>(path);
+        else vec_ = V<T>(path);
+        update_();
+    }
+
+    /* must be called before init_file() to take effect */
+    void set_mapped(bool mapped) { mapped_ = mapped; }
+
+    bool mapped() const { return mapped_; }
+
+    void init_file(std::string path, size_t size) {
+        if (mapped_) mm_.init_file(path, size);
+        else vec_.init_file(path, size);
+        update_();
+    }
+
+    /* only valid for writable M and V */
+    reference operator[](const size_type i) noexcept { return const_cast<T*>(p_)[i]; }
+    const_reference operator[](const size_type i) const noexcept { return p_[i]; }
+
+    size_t size() const noexcept { return n_; }
+
+    const T* data() const noexcept { return p_; }
+
+    void advise(MMapPolicy p) { if (mapped_) mm_.advise(p); }
+
+    void prefetch(size_t i, size_t n) const { if (mapped_) mm_.prefetch(i, n); }
+
+    /* only valid for M = MMapFileSink */
+    void sync() { if (mapped_) mm_.sync(); }
+
+    std::string path() const { return mapped_ ? mm_.path() : std::string(); }
+
+    private:
+
+    void update_() {
+        const M<T>& m = mm_;
+        const V<T>& v = vec_;
+        p_ = mapped_ ? m.data() : v.data();
+        n_ = mapped_ ? m.size() : v.size();
+    }
+
+    bool mapped_ = false;
+    M<T> mm_;
+    V<T> vec_;
+    const T* p_ = NULL;
+    size_t n_ = 0;
+};
+
+template<typename T>
+using PlacedFileSource = PlacedFile<T, MMapFileSource, VecFileSource>;
+
+template<typename T>
+using PlacedFileSink = PlacedFile<T, MMapFileSink, VecFileSinkPrivate>;
+
+template<typename T>
+using PlacedFileSinkPrivate = PlacedFile<T, MMapFileSinkPrivate, VecFileSinkPrivate>;
+
+/* opens C from path, mapped or not, for containers that support the choice */
+template<typename C>
+auto open_placed_(std::string path, bool mapped, int) -> decltype(C(path, mapped)) { return C(path, mapped); }
+template<typename C>
+C open_placed_(std::string path, bool, long) { return C(path); }
+template<typename C>
+C open_placed(std::string path, bool mapped) { return open_placed_<C>(path, mapped, 0); }
+
+template<typename C>
+auto set_placed_(C& c, bool mapped, int) -> decltype(c.set_mapped(mapped), void()) { c.set_mapped(mapped); }
+template<typename C>
+void set_placed_(C&, bool, long) {}
+template<typename C>
+void set_placed(C& c, bool mapped) { set_placed_(c, mapped, 0); }
+
+/* writes c to path, or only flushes it if c is already a shared mapping of
+ * path. Written to a temp file and renamed, so that the file is never seen
+ * half-written and a mapping of the old file stays valid
+ */
+template<typename C>
+auto synced_in_place_(C& c, const std::string& path, int) -> decltype(c.sync(), bool()) {
+    if (c.path() != path) return false;
+    c.sync();
+    return true;
+}
+template<typename C>
+bool synced_in_place_(C&, const std::string&, long) { return false; }
+
+template<typename C>
+void save_container(C& c, std::string path) {
+    if (synced_in_place_(c, path, 0)) return;
+    std::string tmp = path + ".tmp";
+    FILE* fp = fopen(tmp.data(), "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "%s: ", tmp.data());
+        die_("error opening file");
+    }
+    if (fwrite(c.data(), sizeof(typename C::value_type), c.size(), fp) != c.size() ||
+        fflush(fp) || fsync(fileno(fp))) {
+        die_("unable to write data");
+    }
+    fclose(fp);
+    if (rename(tmp.data(), path.data())) die_("unable to rename file");
+}
 #endif
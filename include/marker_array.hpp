@@ -134,16 +134,16 @@ class MarkerPositionsWriter {
 template<template<typename> typename ReadConType=VecFileSource>
 using MarkerPositions = rle_window_arr<ReadConType>;
 
-template <typename MPos=MarkerPositions<>>
-void write_marker_array(std::string mai_fname, std::string sa_fname, std::string output = "") {
-    FILE* sa_fp = sa_fname == "-" ? stdin : fopen(sa_fname.data(), "rb");
-    FILE* ofp = fopen(output == "" ? "out" : output.data(), "wb");
-    MPos mai(mai_fname);
+/* writes the marker array of the SA values read from sa_fp (sa_bytes each,
+ * see below) to ofp, numbering rows from first_row (for segments of the
+ * SA). mai is only read, so it can be shared between threads */
+template <typename MPos>
+uint64_t write_marker_array(const MPos& mai, FILE* sa_fp, FILE* ofp, size_t sa_bytes, uint64_t first_row = 0) {
     constexpr uint64_t delim = -1;
-    uint64_t s;
-    uint64_t i = 0;
+    uint64_t s = 0;
+    uint64_t i = first_row;
     std::vector<uint64_t> markers, pmarkers, locs;
-    while (fread(&s, sizeof(uint64_t), 1, sa_fp) == 1) {
+    while (fread(&s, sa_bytes, 1, sa_fp) == 1) {
         markers.clear();
         markers = mai.at(s);
         if (!vec_eq(markers, pmarkers)) {
@@ -169,8 +169,20 @@ void write_marker_array(std::string mai_fname, std::string sa_fname, std::string
         }
         fwrite(&delim, sizeof(uint64_t), 1, ofp);
     }
+    return i - first_row;
+}
+
+/* sa_bytes: width of the SA values, 8 or SABYTES for pfbwt-f64 --packed-sa
+ * (little-endian, as written by write_myint) */
+template <typename MPos=MarkerPositions<>>
+uint64_t write_marker_array(std::string mai_fname, std::string sa_fname, std::string output = "", size_t sa_bytes = sizeof(uint64_t)) {
+    FILE* sa_fp = sa_fname == "-" ? stdin : fopen(sa_fname.data(), "rb");
+    FILE* ofp = fopen(output == "" ? "out" : output.data(), "wb");
+    MPos mai(mai_fname);
+    uint64_t i = write_marker_array(mai, sa_fp, ofp, sa_bytes);
     fclose(sa_fp);
     fclose(ofp);
+    return i; // # of SA entries read
 }
 
 template<template<typename> typename ReadConType=VecFileSource>
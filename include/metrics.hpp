@@ -0,0 +1,234 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+/* Author: Taher Mun
+ * per-phase metrics (wall/CPU time, peak RSS, I/O) and algorithm counters,
+ * written as JSON w/ --metrics so that runs can be compared automatically
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cinttypes>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include "parallel_hashmap/meminfo.h"
+
+namespace pfbwtf {
+
+/* snapshot of the resources used by this process so far */
+struct ResourceUsage {
+    double wall = 0; // seconds since epoch
+    double cpu = 0; // user + sys seconds
+    uint64_t rchar = 0, wchar = 0; // bytes passed to read/write syscalls
+    uint64_t read_bytes = 0, write_bytes = 0; // bytes fetched from/sent to storage (incl. mmap)
+    uint64_t major_faults = 0;
+
+    static ResourceUsage now() {
+        ResourceUsage u;
+        u.wall = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+        struct rusage ru;
+        if (!getrusage(RUSAGE_SELF, &ru)) {
+            u.cpu = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+            u.major_faults = ru.ru_majflt;
+        }
+        std::FILE* fp = fopen("/proc/self/io", "r");
+        if (fp != NULL) {
+            char k[64];
+            uint64_t v;
+            while (fscanf(fp, "%63s %" SCNu64, k, &v) == 2) {
+                if (!strcmp(k, "rchar:")) u.rchar = v;
+                else if (!strcmp(k, "wchar:")) u.wchar = v;
+                else if (!strcmp(k, "read_bytes:")) u.read_bytes = v;
+                else if (!strcmp(k, "write_bytes:")) u.write_bytes = v;
+            }
+            fclose(fp);
+        }
+        return u;
+    }
+};
+
+/* peak RSS in bytes since the last reset_peak_rss() (or since the process
+ * started, if resetting is not supported) */
+uint64_t peak_rss() {
+    std::FILE* fp = fopen("/proc/self/status", "r");
+    uint64_t kb = 0;
+    if (fp != NULL) {
+        char line[128];
+        while (fgets(line, sizeof(line), fp) != NULL) {
+            if (!strncmp(line, "VmHWM:", 6)) {
+                kb = strtoull(line + 6, NULL, 10);
+                break;
+            }
+        }
+        fclose(fp);
+    }
+    if (!kb) { // no procfs
+        struct rusage ru;
+        if (!getrusage(RUSAGE_SELF, &ru)) kb = ru.ru_maxrss;
+    }
+    return kb * 1024;
+}
+
+/* resets the kernel's peak RSS counter (Linux >= 4.0) */
+void reset_peak_rss() {
+    std::FILE* fp = fopen("/proc/self/clear_refs", "w");
+    if (fp == NULL) return;
+    fputs("5", fp);
+    fclose(fp);
+}
+
+/* collects phases, counters and histograms, and writes them out as JSON.
+ * does nothing until open() is called, so instrumented code costs only a
+ * branch when --metrics is not given. use via metrics()
+ */
+class Metrics {
+
+    public:
+
+    struct Phase {
+        std::string name;
+        ResourceUsage start;
+        ResourceUsage end;
+        uint64_t peak_rss = 0;
+        uint64_t vm_size = 0;
+        bool done = false;
+    };
+
+    void open(std::string fname, std::string program) {
+        fname_ = fname;
+        program_ = program;
+    }
+
+    bool enabled() const { return fname_ != ""; }
+
+    /* returns an id for end_phase(). phases may nest */
+    size_t begin_phase(std::string name) {
+        if (!enabled()) return 0;
+        fold_peak_rss();
+        reset_peak_rss();
+        Phase p;
+        p.name = name;
+        p.start = ResourceUsage::now();
+        phases_.push_back(p);
+        return phases_.size() - 1;
+    }
+
+    void end_phase(size_t id) {
+        if (!enabled()) return;
+        fold_peak_rss();
+        Phase& p = phases_[id];
+        p.end = ResourceUsage::now();
+        p.vm_size = spp::GetProcessMemoryUsed();
+        p.done = true;
+    }
+
+    void set(std::string key, double v) {
+        if (enabled()) counters_[key] = v;
+    }
+
+    const std::vector<Phase>& get_phases() const { return phases_; }
+
+    /* adds h (counts per power-of-two bucket, see Histogram) to histogram key */
+    void add_histogram(std::string key, const std::vector<uint64_t>& h) {
+        if (!enabled()) return;
+        auto& dst = histograms_[key];
+        if (dst.size() < h.size()) dst.resize(h.size(), 0);
+        for (size_t i = 0; i < h.size(); ++i) dst[i] += h[i];
+    }
+
+    void write() const {
+        if (!enabled()) return;
+        std::FILE* fp = fopen(fname_.data(), "w");
+        if (fp == NULL) {
+            fprintf(stderr, "could not write metrics to %s\n", fname_.data());
+            return;
+        }
+        fprintf(fp, "{\n  \"program\": \"%s\",\n  \"phases\": [", program_.data());
+        size_t k = 0;
+        for (const Phase& p: phases_) {
+            if (!p.done) continue;
+            fprintf(fp, "%s\n    {\"name\": \"%s\", \"wall_s\": %.3f, \"cpu_s\": %.3f, "
+                        "\"peak_rss\": %" PRIu64 ", \"vm_size\": %" PRIu64 ", "
+                        "\"rchar\": %" PRIu64 ", \"wchar\": %" PRIu64 ", "
+                        "\"read_bytes\": %" PRIu64 ", \"write_bytes\": %" PRIu64 ", "
+                        "\"major_faults\": %" PRIu64 "}",
+                    k++ ? "," : "", p.name.data(), p.end.wall - p.start.wall, p.end.cpu - p.start.cpu,
+                    p.peak_rss, p.vm_size,
+                    p.end.rchar - p.start.rchar, p.end.wchar - p.start.wchar,
+                    p.end.read_bytes - p.start.read_bytes, p.end.write_bytes - p.start.write_bytes,
+                    p.end.major_faults - p.start.major_faults);
+        }
+        fprintf(fp, "\n  ],\n  \"peak_rss\": %" PRIu64 ",\n  \"counters\": {", max_rss());
+        k = 0;
+        for (const auto& c: counters_) {
+            fprintf(fp, "%s\n    \"%s\": %.17g", k++ ? "," : "", c.first.data(), c.second);
+        }
+        fprintf(fp, "\n  },\n  \"histograms\": {");
+        k = 0;
+        for (const auto& h: histograms_) {
+            // keys are the lower bounds of the buckets
+            fprintf(fp, "%s\n    \"%s\": {", k++ ? "," : "", h.first.data());
+            size_t b = 0;
+            for (size_t i = 0; i < h.second.size(); ++i) {
+                if (!h.second[i]) continue;
+                fprintf(fp, "%s\"%" PRIu64 "\": %" PRIu64, b++ ? ", " : "", i ? static_cast<uint64_t>(1) << (i-1) : static_cast<uint64_t>(0), h.second[i]);
+            }
+            fprintf(fp, "}");
+        }
+        fprintf(fp, "\n  }\n}\n");
+        fclose(fp);
+    }
+
+    private:
+
+    /* the kernel keeps one peak counter, which is reset at every phase start;
+     * fold it into all open phases first so that enclosing phases keep theirs
+     */
+    void fold_peak_rss() {
+        uint64_t p = peak_rss();
+        for (auto& ph: phases_) {
+            if (!ph.done && p > ph.peak_rss) ph.peak_rss = p;
+        }
+        if (p > max_rss_) max_rss_ = p;
+    }
+
+    uint64_t max_rss() const {
+        uint64_t p = peak_rss();
+        return p > max_rss_ ? p : max_rss_;
+    }
+
+    std::string fname_;
+    std::string program_;
+    std::vector<Phase> phases_;
+    std::map<std::string, double> counters_;
+    std::map<std::string, std::vector<uint64_t>> histograms_;
+    uint64_t max_rss_ = 0;
+};
+
+Metrics& metrics() {
+    static Metrics m;
+    return m;
+}
+
+/* counts per power-of-two bucket: bucket 0 holds 0, bucket i holds [2^(i-1), 2^i) */
+struct Histogram {
+    void add(uint64_t x) {
+        size_t b = x ? 64 - __builtin_clzll(x) : 0;
+        if (b >= counts.size()) counts.resize(b + 1, 0);
+        ++counts[b];
+    }
+    std::vector<uint64_t> counts;
+};
+
+/* records a metrics phase for the lifetime of the object */
+struct MetricsPhase {
+    MetricsPhase(std::string name) : id(metrics().begin_phase(name)) {}
+    ~MetricsPhase() { metrics().end_phase(id); }
+    size_t id;
+};
+
+}; // namespace end
+#endif
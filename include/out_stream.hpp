@@ -0,0 +1,262 @@
+#ifndef OUT_STREAM_HPP
+#define OUT_STREAM_HPP
+
+/* Author: Taher Mun
+ * buffered output stream w/ a background writer (double buffering): puts
+ * are copied into one buffer while the other is being written, so the BWT
+ * step only waits on the disk when it produces output faster than the disk
+ * takes it. Time spent waiting is recorded as backpressure.
+ * w/ O_DIRECT, full buffers are written unbuffered by the page cache. The
+ * stream drops back to plain writes once a write is not block-aligned
+ * (the last buffer, a checkpoint flush, or resuming at an odd offset), or
+ * if the filesystem refuses O_DIRECT.
+ * A stream can also be split into segments of a fixed size (see
+ * segments.hpp): the writer moves on to the next file once one is full.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+extern "C" {
+#include "utils.h"
+}
+
+namespace pfbwtf {
+
+struct OutStreamParams {
+    size_t buf_bytes = 8 << 20; // per buffer, two per stream
+    bool async = true; // write from a background thread
+    bool direct = false; // open w/ O_DIRECT
+    uint64_t seg_bytes = 0; // segment size, for segmented streams
+};
+
+/* opens segment k of a segmented stream for writing, returns its fd */
+using SegmentOpener = std::function<int(size_t)>;
+
+class OutStream {
+
+    public:
+
+    static constexpr size_t ALIGN = 4096;
+
+    /* takes ownership of fd, which is written from its current offset */
+    OutStream(int fd, std::string name, OutStreamParams p) :
+        fd_(fd), name_(name), async_(p.async)
+    {
+        size_ = std::max(ALIGN, (p.buf_bytes + ALIGN - 1) / ALIGN * ALIGN);
+        for (auto& b: bufs_) {
+            if (posix_memalign(reinterpret_cast<void**>(&b), ALIGN, size_)) die("could not allocate output buffer");
+        }
+        off_t off = lseek(fd_, 0, SEEK_CUR);
+        start_ = off < 0 ? 0 : off; // pipes can't seek
+        direct_ = (fcntl(fd_, F_GETFL) & O_DIRECT) != 0;
+        if (async_) writer_ = std::thread(&OutStream::writer_loop, this);
+    }
+
+    /* writes to segments of p.seg_bytes bytes, opened w/ open_seg */
+    OutStream(SegmentOpener open_seg, std::string name, OutStreamParams p) :
+        OutStream(open_seg(0), name, p)
+    {
+        open_seg_ = open_seg;
+        seg_bytes_ = std::max<uint64_t>(1, p.seg_bytes);
+        seg_left_ = seg_bytes_;
+        nsegs_ = 1;
+    }
+
+    ~OutStream() { close(); }
+
+    OutStream(const OutStream&) = delete;
+    OutStream& operator=(const OutStream&) = delete;
+
+    template<typename T>
+    void put(const T& x) { write(&x, sizeof(x)); }
+
+    void write(const void* p, size_t len) {
+        if (fill_ + len <= size_) { // fast path
+            memcpy(bufs_[cur_] + fill_, p, len);
+            fill_ += len;
+            return;
+        }
+        const uint8_t* s = static_cast<const uint8_t*>(p);
+        while (len) {
+            size_t k = std::min(len, size_ - fill_);
+            memcpy(bufs_[cur_] + fill_, s, k);
+            fill_ += k;
+            s += k;
+            len -= k;
+            if (fill_ == size_) hand_off();
+        }
+    }
+
+    /* bytes put so far, counting from the offset the fd had when opened */
+    uint64_t tell() const { return start_ + handed_ + fill_; }
+
+    /* waits until everything put so far is written */
+    void flush() {
+        hand_off();
+        wait_idle();
+    }
+
+    /* flushes and syncs to disk (for checkpoints) */
+    void sync() {
+        flush();
+        if (fsync(fd_) && errno != EINVAL) die("could not flush file to disk"); // EINVAL: pipes
+    }
+
+    void close() {
+        if (closed_) return;
+        closed_ = true;
+        flush();
+        if (async_) {
+            {
+                std::lock_guard<std::mutex> lk(m_);
+                done_ = true;
+            }
+            cv_.notify_all();
+            writer_.join();
+        }
+        if (fd_ != STDOUT_FILENO && ::close(fd_)) die("could not close output");
+        fd_ = -1;
+        for (auto b: bufs_) free(b);
+    }
+
+    const std::string& name() const { return name_; }
+
+    /* sizes of the segments written, once closed (empty if not segmented) */
+    std::vector<uint64_t> segment_sizes() const {
+        std::vector<uint64_t> v(nsegs_, seg_bytes_);
+        if (nsegs_) v.back() = tell() - (nsegs_ - 1) * seg_bytes_;
+        return v;
+    }
+
+    // backpressure: times a full buffer had to wait for the previous one
+    uint64_t stalls() const { return stalls_; }
+    double stall_secs() const { return stall_secs_; }
+
+    private:
+
+    /* passes the current buffer to the writer, after the previous one is written */
+    void hand_off() {
+        if (!fill_) return;
+        if (!async_) {
+            write_all(bufs_[cur_], fill_);
+        } else {
+            std::unique_lock<std::mutex> lk(m_);
+            if (pending_) {
+                auto t = std::chrono::steady_clock::now();
+                cv_.wait(lk, [&]{ return !pending_; });
+                ++stalls_;
+                stall_secs_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+            }
+            pending_ = bufs_[cur_];
+            pending_len_ = fill_;
+            lk.unlock();
+            cv_.notify_all();
+            cur_ ^= 1;
+        }
+        handed_ += fill_;
+        fill_ = 0;
+    }
+
+    void wait_idle() {
+        if (!async_) return;
+        std::unique_lock<std::mutex> lk(m_);
+        cv_.wait(lk, [&]{ return !pending_; });
+        if (err_) die("could not write output");
+    }
+
+    void writer_loop() {
+        std::unique_lock<std::mutex> lk(m_);
+        while (true) {
+            cv_.wait(lk, [&]{ return pending_ || done_; });
+            if (!pending_) return;
+            uint8_t* b = pending_;
+            size_t len = pending_len_;
+            lk.unlock();
+            bool ok = write_all(b, len, false);
+            lk.lock();
+            err_ = err_ || !ok;
+            pending_ = NULL;
+            cv_.notify_all();
+        }
+    }
+
+    bool write_all(const uint8_t* b, size_t len, bool die_on_err = true) {
+        if (direct_ && (len % ALIGN || (start_ + written_) % ALIGN)) drop_direct();
+        while (len) {
+            size_t k = len;
+            if (seg_bytes_) {
+                if (!seg_left_) next_segment();
+                k = std::min<uint64_t>(k, seg_left_);
+            }
+            ssize_t w = ::write(fd_, b, k);
+            if (w < 0 && errno == EINTR) continue;
+            if (w < 0 && errno == EINVAL && direct_) { // O_DIRECT refused
+                drop_direct();
+                continue;
+            }
+            if (w <= 0) {
+                if (die_on_err) die("could not write output");
+                return false;
+            }
+            b += w;
+            len -= w;
+            written_ += w;
+            if (seg_bytes_) seg_left_ -= w;
+        }
+        return true;
+    }
+
+    void next_segment() {
+        if (::close(fd_)) die("could not close output segment");
+        fd_ = open_seg_(nsegs_++);
+        direct_ = (fcntl(fd_, F_GETFL) & O_DIRECT) != 0;
+        seg_left_ = seg_bytes_;
+    }
+
+    void drop_direct() {
+        fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT);
+        direct_ = false;
+    }
+
+    int fd_ = -1;
+    std::string name_;
+    bool async_;
+    bool direct_ = false;
+    size_t size_ = 0;
+    uint8_t* bufs_[2] = {NULL, NULL};
+    int cur_ = 0;
+    size_t fill_ = 0;
+    uint64_t start_ = 0;
+    uint64_t handed_ = 0;
+    uint64_t written_ = 0; // by write_all, for O_DIRECT alignment
+    uint64_t stalls_ = 0;
+    double stall_secs_ = 0;
+    std::thread writer_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    uint8_t* pending_ = NULL;
+    size_t pending_len_ = 0;
+    bool done_ = false;
+    bool err_ = false;
+    bool closed_ = false;
+    SegmentOpener open_seg_;
+    uint64_t seg_bytes_ = 0;
+    uint64_t seg_left_ = 0; // in the current segment
+    size_t nsegs_ = 0;
+};
+
+}; // namespace end
+#endif
@@ -0,0 +1,151 @@
+#ifndef PACKED_BWT_HPP
+#define PACKED_BWT_HPP
+
+/* Author: Taher Mun
+ * BWT w/ 2 bits per char (pfbwt-f64 --packed-bwt):
+ * <prefix>.bwt.2bit holds the number of rows (uint64), then the codes of
+ * A, C, G, T (0-3), 32 per little-endian uint64 word, row i at bits
+ * 2*(i%32). Every other char (the terminator, N, ...) is an exception: its
+ * code is 0 and <prefix>.bwt.exc holds its run of equal exceptions as a
+ * (first row, length, char) triple of uint64s, in row order (runs of Ns are
+ * long, so this stays small).
+ */
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "file_wrappers.hpp"
+#include "out_stream.hpp"
+extern "C" {
+#include "utils.h"
+}
+
+namespace pfbwtf {
+
+static const uint8_t packed_bwt_chars[4] = {'A', 'C', 'G', 'T'};
+
+// code of c, or 4 if c is an exception
+inline uint8_t packed_bwt_code(uint8_t c) {
+    switch (c) {
+        case 'A': return 0;
+        case 'C': return 1;
+        case 'G': return 2;
+        case 'T': return 3;
+        default: return 4;
+    }
+}
+
+class PackedBWTWriter {
+
+    public:
+
+    PackedBWTWriter() {}
+
+    PackedBWTWriter(OutStream* codes, OutStream* exc) : codes_(codes), exc_(exc) {}
+
+    /* number of rows. call before any push, unless resuming */
+    void write_header(uint64_t n) { codes_->put(n); }
+
+    void push(uint8_t c) {
+        uint64_t code = packed_bwt_code(c);
+        if (code == 4) {
+            if (!exc_len || c != exc_c || row != exc_row + exc_len) {
+                flush_exc();
+                exc_row = row;
+                exc_c = c;
+            }
+            ++exc_len;
+            code = 0;
+        }
+        word |= code << (2 * (row % 32));
+        if (++row % 32 == 0) flush_word();
+    }
+
+    /* writes the last, partial word. call once all chars are pushed */
+    void finish() {
+        if (row % 32) flush_word();
+        flush_exc();
+    }
+
+    // rows pushed, the current (unwritten) word and exception run, restored
+    // by checkpoints
+    uint64_t row = 0;
+    uint64_t word = 0;
+    uint64_t exc_row = 0;
+    uint64_t exc_len = 0;
+    uint64_t exc_c = 0;
+
+    private:
+
+    void flush_exc() {
+        if (!exc_len) return;
+        exc_->put(exc_row);
+        exc_->put(exc_len);
+        exc_->put(exc_c);
+        exc_len = 0;
+    }
+
+    void flush_word() {
+        codes_->put(word);
+        word = 0;
+    }
+
+    OutStream* codes_ = NULL;
+    OutStream* exc_ = NULL;
+};
+
+class PackedBWT {
+
+    public:
+
+    PackedBWT() {}
+
+    PackedBWT(std::string prefix) : codes_(prefix + "." + EXTPKBWT) {
+        n_ = codes_[0];
+        if (codes_.size() != 1 + (n_ + 31) / 32) die("packed BWT has the wrong size");
+        VecFileSource<uint64_t> exc(prefix + "." + EXTPKEXC);
+        if (exc.size() % 3) die("packed BWT exceptions have the wrong size");
+        for (size_t k = 0; k < exc.size(); k += 3) {
+            exc_rows_.push_back(exc[k]);
+            exc_lens_.push_back(exc[k+1]);
+            exc_chars_.push_back(exc[k+2]);
+        }
+    }
+
+    uint64_t size() const { return n_; }
+
+    uint8_t operator[](uint64_t i) const {
+        // last exception run starting at or before i
+        size_t k = std::upper_bound(exc_rows_.begin(), exc_rows_.end(), i) - exc_rows_.begin();
+        if (k && i < exc_rows_[k-1] + exc_lens_[k-1]) return exc_chars_[k-1];
+        return packed_bwt_chars[code(i)];
+    }
+
+    /* calls f on each char in row order, w/o searching the exceptions */
+    template<typename Fn>
+    void scan(Fn f) const {
+        size_t k = 0;
+        for (uint64_t i = 0; i < n_; ++i) {
+            if (k < exc_rows_.size() && exc_rows_[k] <= i) {
+                f(exc_chars_[k]);
+                if (i + 1 == exc_rows_[k] + exc_lens_[k]) ++k;
+            } else {
+                f(packed_bwt_chars[code(i)]);
+            }
+        }
+    }
+
+    private:
+
+    uint8_t code(uint64_t i) const { return (codes_[1 + i / 32] >> (2 * (i % 32))) & 3; }
+
+    MMapFileSource<uint64_t> codes_;
+    uint64_t n_ = 0;
+    std::vector<uint64_t> exc_rows_; // first row of each exception run
+    std::vector<uint64_t> exc_lens_;
+    std::vector<uint8_t> exc_chars_;
+};
+
+}; // namespace end
+#endif
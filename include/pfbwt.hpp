@@ -9,6 +9,12 @@
 #include <fcntl.h>
 #include "sdsl/bit_vectors.hpp"
 #include "sdsl_bv_wrappers.hpp"
+#include "dict_sort.hpp"
+#include "bwt_workspace.hpp"
+#include "file_wrappers.hpp"
+#include "checkpoint.hpp"
+#include "metrics.hpp"
+#include "range_min.hpp"
 // #include "sa_aux.hpp"
 extern "C" {
 #include <sys/mman.h>
@@ -19,10 +25,10 @@ extern "C" {
 namespace pfbwtf {
 
 struct SuffixT {
-    SuffixT(uint8_t c, uint_t i, uint_t w) : bwtc(c), bwtp(i), wordi(w) {}
+    SuffixT(uint8_t c, uint_t i, uint_t s) : bwtc(c), bwtp(i), sai(s) {}
     uint8_t bwtc;
     uint_t bwtp;
-    uint_t wordi;
+    uint_t sai; // bwsai at bwtp
     bool operator<(SuffixT& r);
 };
 
@@ -34,25 +40,148 @@ enum class RunType {OTHER, START, END};
 enum class Difficulty {EASY1, EASY2, HARD};
 
 struct out_fn_arg {
-    out_fn_arg(uint_t p, uint_t s, uint8_t pc, uint8_t c, Difficulty d = Difficulty::EASY1) :
-        pos(p), sa(s), pbwtc(pc), bwtc(c), dif(d) {}
+    out_fn_arg(uint_t p, uint_t s, uint8_t pc, uint8_t c, Difficulty d = Difficulty::EASY1, uint_t l = 0) :
+        pos(p), sa(s), pbwtc(pc), bwtc(c), dif(d), lcp(l) {}
     uint_t pos;
     uint_t sa;
     uint8_t pbwtc;
     uint8_t bwtc;
     Difficulty dif;
+    uint_t lcp; // w/ the previous row (only if PrefixFreeBWTParams::lcp)
+};
+
+/* count equal BWT chars c from row pos on, as delivered by
+ * generate_bwt_runs. sa and lcp point to count SA values and LCPs (as in
+ * out_fn_arg, so row 0's SA value is not meaningful: it is the suffix at
+ * the terminator), or are NULL if the BWT is built w/o them. They are only
+ * valid during the callback.
+ */
+struct BWTRun {
+    uint64_t pos = 0;
+    uint8_t c = 0;
+    uint64_t count = 0;
+    const uint_t* sa = NULL;
+    const uint_t* lcp = NULL;
+};
+
+/* hands the rows of PrefixFreeBWT::generate_bwt to a per-row out_fn, one
+ * out_fn_arg at a time
+ */
+template<typename Fn>
+struct RowEmitter {
+    Fn& out_fn;
+    void row(uint64_t pos, uint8_t pbwtc, uint8_t c, uint_t sa, uint_t lcp, Difficulty d) {
+        out_fn(out_fn_arg(pos, sa, pbwtc, c, d, lcp));
+    }
+    /* n rows of c from pos on, w/ their SA values and LCPs (or NULL) */
+    void span(uint64_t pos, uint8_t pbwtc, uint8_t c, uint64_t n, const uint_t* sa, const uint_t* lcp, Difficulty d) {
+        for (uint64_t k = 0; k < n; ++k) {
+            row(pos + k, k ? c : pbwtc, c, sa ? sa[k] : 0, lcp ? lcp[k] : 0, d);
+        }
+    }
+    void cut() {}
+};
+
+/* gathers the rows of PrefixFreeBWT::generate_bwt into runs of equal chars,
+ * at most max_run long, and hands them to run_fn(const BWTRun&). cut() ends
+ * the current run
+ */
+template<typename RunFn>
+struct RunEmitter {
+    RunEmitter(RunFn& f, uint64_t pos, bool sa, bool lcp, size_t max) :
+        run_fn(f), with_sa(sa), with_lcp(lcp), max_run(max) { run.pos = pos; }
+    void row(uint64_t pos, uint8_t pbwtc, uint8_t c, uint_t sa, uint_t lcp, Difficulty d) {
+        span(pos, pbwtc, c, 1, with_sa ? &sa : NULL, with_lcp ? &lcp : NULL, d);
+    }
+    void span(uint64_t, uint8_t, uint8_t c, uint64_t n, const uint_t* sa, const uint_t* lcp, Difficulty) {
+        if (run.count && c != run.c) cut();
+        run.c = c;
+        while (n) {
+            if (run.count == max_run) cut();
+            uint64_t k = std::min<uint64_t>(n, max_run - run.count);
+            if (sa) sa_buf.insert(sa_buf.end(), sa, sa + k), sa += k;
+            if (lcp) lcp_buf.insert(lcp_buf.end(), lcp, lcp + k), lcp += k;
+            run.count += k;
+            n -= k;
+        }
+    }
+    void cut() {
+        if (!run.count) return;
+        run.sa = with_sa ? sa_buf.data() : NULL;
+        run.lcp = with_lcp ? lcp_buf.data() : NULL;
+        run_fn(static_cast<const BWTRun&>(run));
+        run.pos += run.count;
+        run.count = 0;
+        sa_buf.clear();
+        lcp_buf.clear();
+    }
+
+    RunFn& run_fn;
+    bool with_sa, with_lcp;
+    uint64_t max_run;
+    BWTRun run;
+    std::vector<uint_t> sa_buf, lcp_buf;
+};
+
+/* state of generate_bwt_lcp at a gSA group boundary: the next gSA entry to
+ * process, the number of BWT chars output so far, the last one of them, and
+ * the dict suffix it came from (for LCP)
+ */
+struct BWTProgress {
+    uint64_t i = 0;
+    uint64_t pos = 0;
+    uint8_t pbwtc = 0;
+    uint64_t prev_suf = 0;
+};
+
+/* how suffixes of the dictionary are sorted before building the BWT
+ * FULL:   gSACAK over the whole dict, w/ gLCP
+ * SPARSE: only suffixes longer than w are sorted, groups are kept in a bitvector
+ * EXTERNAL: same as SPARSE, but sorted in blocks on disk and merged sequentially
+ * with FULL and glcp=false, gSACAK skips the LCP and groups are found by
+ * comparing neighbouring suffixes in gSA
+ */
+enum class DictSort {FULL, SPARSE, EXTERNAL};
+
+/* per-array choice of mmap (true) vs. RAM, for containers that support it
+ * (PlacedFile). Ignored by the other containers.
+ */
+struct WorkspacePlacement {
+    bool dict = false;
+    bool gsa = false;
+    bool glcp = false;
+    bool ilist = false; // also ilist records
+    bool bwlast = false;
+    bool bwsai = false;
+    bool bwlcp = false;
 };
 
 struct PrefixFreeBWTParams {
     std::string prefix;
+    std::string scratch; // prefix of gSA/gLCP and their sort runs [default: prefix]
     size_t w;
     bool sa = false;
     bool rssa = false;
+    bool lcp = false; // LCP of the text, from the dict and .bwlcp
     bool verb = false;
+    DictSort dict_sort = DictSort::FULL;
+    bool glcp = true; // if false, gLCP is not built (FULL only)
+    size_t ext_block = 1UL << 26; // gSA entries per sorted block (EXTERNAL only)
+    bool ilist_records = false; // read ilist, bwlast and bwsai from .ilrec
+    bool compressed = false; // read ilist and bwlast from .cilist and .pbwlast
+    bool mmap_populate = false; // pre-fault randomly accessed mmap'd arrays
+    bool mmap_thp = false; // ask for transparent huge pages on mmap'd arrays
+    WorkspacePlacement placement;
+    bool checkpoint = false; // save gSA/gLCP w/ a manifest once sorted
+    bool resume = false; // reuse gSA/gLCP from a valid checkpoint
 };
 
+/* DictConType holds the dict, which gSACAK needs writable but which is
+ * never written to, so a private (copy-on-write) container fits it best
+ */
 template<template <typename, typename...> typename ReadConType,
-         template <typename, typename...> typename WriteConType
+         template <typename, typename...> typename WriteConType,
+         template <typename, typename...> typename DictConType = WriteConType
          >
 class PrefixFreeBWT {
 
@@ -63,68 +192,156 @@ class PrefixFreeBWT {
 
     PrefixFreeBWT(PrefixFreeBWTParams args) :
         fname(args.prefix),
+        scratch(args.scratch == "" ? args.prefix : args.scratch),
         w ( args.w),
-        dict ( WriteConType<uint8_t>(args.prefix + "." + EXTDICT)),
-        bwlast ( ReadConType<uint8_t>(args.prefix + "." + EXTBWLST)),
-        ilist ( ReadConType<UIntType>(args.prefix + "." + EXTILIST)),
+        dict ( open_placed<DictConType<uint8_t>>(args.prefix + "." + EXTDICT, args.placement.dict)),
+        bwlast ( args.ilist_records || args.compressed ? ReadConType<uint8_t>() : open_placed<ReadConType<uint8_t>>(args.prefix + "." + EXTBWLST, args.placement.bwlast)),
+        ilist ( args.ilist_records || args.compressed ? ReadConType<UIntType>() : open_placed<ReadConType<UIntType>>(args.prefix + "." + EXTILIST, args.placement.ilist)),
         build_sa(args.sa), build_rssa(args.rssa),
         any_sa(args.sa | args.rssa),
-        verbose(args.verb)
+        text_lcp(args.lcp),
+        verbose(args.verb),
+        dict_sort(args.dict_sort),
+        build_glcp(args.glcp),
+        ext_block(args.ext_block),
+        use_records(args.ilist_records),
+        use_compressed(args.compressed),
+        mmap_populate(args.mmap_populate),
+        mmap_thp(args.mmap_thp),
+        placement(args.placement),
+        checkpoint(args.checkpoint),
+        resume(args.resume)
     {
+        if (use_records && use_compressed) die("ilist records and compressed workspace are exclusive");
         if (verbose) fprintf(stderr, "loaded files\n");
         // if (args.sa && args.rssa) die("cannot activate both SA and sampled-SA options!");
         dsize = dict.size();
         if (verbose) fprintf(stderr, "creating ilist idx\n");
         // if (args.sa && args.rssa) die("cannot activate both SA and sampled-SA options!");
         load_ilist_idx(args.prefix);
-        if (args.sa || args.rssa) bwsai = ReadConType<UIntType>(args.prefix + "." + EXTBWSAI);
+        if (use_records) {
+            irecs = open_placed<ReadConType<IlistRecord<UIntType>>>(args.prefix + "." + EXTILREC, args.placement.ilist);
+        } else if (args.sa || args.rssa) {
+            bwsai = open_placed<ReadConType<UIntType>>(args.prefix + "." + EXTBWSAI, args.placement.bwsai);
+        }
+        if (text_lcp) {
+            bwlcp = open_placed<ReadConType<UIntType>>(args.prefix + "." + EXTBWLCP, args.placement.bwlcp);
+            bwlcp_min = RangeMin<UIntType>(bwlcp);
+        }
+        set_placed(gsa, args.placement.gsa);
+        set_placed(glcp, args.placement.glcp);
+        if (use_compressed) {
+            cilist = DeltaIlist<UIntType>(args.prefix + "." + EXTCILIST);
+            pbwlast = PackedBwlast(args.prefix + "." + EXTPBWLST);
+        }
+        set_access_policies();
     }
 
 #define get_word_suflen(i, d, s) \
     d = dict_idx.rank(i); \
     s = d>=dwords ? dsize-i : dict_idx.select(d+1) - i;
 
-#define UPDATE_SA(pbwtc, bwtc, bwtp, d) \
-    sa = bwtp - suff_len; \
-    out_fn(out_fn_arg(pos, sa, pbwtc, bwtc, d)); \
-
-#define UPDATE_BWT(pbwtc, bwtc, d) \
-    out_fn(out_fn_arg(0,0,pbwtc,bwtc, d));
-
      /* uses LCP of dict to build BWT (less memory, more time)
      */
     template<typename Fn>
     void generate_bwt_lcp(Fn out_fn) {
+        generate_bwt_lcp(out_fn, [](const BWTProgress&) {}, BWTProgress(), 0);
+    }
+
+    /* same as above, but starts from start (see BWTProgress) and calls
+     * ckpt_fn at the first group boundary after every ckpt_every BWT chars.
+     * w/ stop_i, stops at that gSA index (a group boundary, see split_bwt)
+     */
+    template<typename Fn, typename CkptFn>
+    void generate_bwt_lcp(Fn out_fn, CkptFn ckpt_fn, BWTProgress start, uint64_t ckpt_every, uint64_t stop_i = 0) {
+        RowEmitter<Fn> emit{out_fn};
+        generate_bwt(emit, ckpt_fn, start, ckpt_every, stop_i);
+    }
+
+    /* the BWT step behind generate_bwt_lcp and generate_bwt_runs. Rows go to
+     * emit (RowEmitter or RunEmitter): full words (EASY1) as spans of equal
+     * chars of their occurrences, single char groups (EASY2) as one span per
+     * word (w/o even reading its occurrences if neither SA nor LCP is
+     * needed), and sorted hard groups row by row
+     */
+    template<typename Emitter, typename CkptFn>
+    void generate_bwt(Emitter& emit, CkptFn ckpt_fn, BWTProgress start, uint64_t ckpt_every, uint64_t stop_i) {
         if (verbose) fprintf(stderr, "generating dict suffixes\n");
-        sort_dict_suffixes(true); // build gSA and gLCP of dict
+        prepare_dict_suffixes(); // build gSA and gLCP (or groups) of dict
+        mmap_advise(gsa, policy(MMapAccess::SEQUENTIAL));
+        mmap_advise(glcp, policy(MMapAccess::SEQUENTIAL));
         // start from SA item that's not EndOfWord or EndOfDict
         size_t next, suff_len, wordi;
-        uint8_t pbwtc=0, bwtc;
+        uint8_t pbwtc=start.pbwtc;
         uint64_t easy_cases = 0, hard_cases = 0;
-        size_t pos = 0;
-        UIntType sa = 0;
+        Histogram hard_groups; // # of suffixes sorted per hard case
+        size_t pos = start.pos;
+        size_t last_ckpt = pos;
+        // LCP w/ the previous row. the first row of a group of equal dict
+        // suffixes only shares a prefix of its suffix w/ the previous group's.
+        // the rest of the group share all of it but the w chars that overlap
+        // the next phrase, then the text from the next phrases, whose LCP is
+        // a range min over .bwlcp as rows are in parse SA order (j)
+        bool group_start = true;
+        size_t prev_suf = start.prev_suf, prev_j = 0;
+        auto row_lcp = [&](size_t suf, size_t suff_len, size_t j) -> UIntType {
+            if (!text_lcp) return 0;
+            UIntType l = 0;
+            if (group_start) {
+                if (pos) l = dict_lcp(prev_suf, suf);
+                prev_suf = suf;
+                group_start = false;
+            } else {
+                l = suff_len - w + bwlcp_min.query(bwlcp, prev_j + 1, j);
+            }
+            prev_j = j;
+            return l;
+        };
+        // w/o SA or LCP, groups of one char need not be sorted
+        bool sorted = any_sa || text_lcp;
         if (verbose) fprintf(stderr, "processing words to build BWT\n");
         std::vector<uint8_t> chars;
         std::vector<uint64_t> words;
         std::vector<SuffixT> suffs;
-        std::vector<size_t> word_ilist;
-        for (size_t i = dwords+w+1; i<dsize; i=next) {
+        std::vector<IlistRecord<UIntType>> word_occs;
+        std::vector<uint_t> sa_span, lcp_span;
+        // rows [a, b) of word_occs, all w/ BWT char c, as one span. word_occs
+        // is only read for SA values and LCPs
+        auto emit_occs = [&](size_t i, size_t suff_len, size_t a, size_t b, uint8_t c, Difficulty d) {
+            sa_span.clear();
+            lcp_span.clear();
+            for (size_t k = a; sorted && k < b; ++k) {
+                UIntType lcp = row_lcp(gsa[i], suff_len, word_occs[k].j);
+                if (any_sa) sa_span.push_back(word_occs[k].sai - suff_len);
+                if (text_lcp) lcp_span.push_back(lcp);
+            }
+            emit.span(pos, pbwtc, c, b - a, any_sa ? sa_span.data() : NULL, text_lcp ? lcp_span.data() : NULL, d);
+            pbwtc = c;
+            pos += b - a;
+            easy_cases += b - a;
+        };
+        size_t end = stop_i ? stop_i : gsa.size();
+        for (size_t i = start.i ? start.i : gstart; i < end; i=next) {
             next = i+1;
+            if (ckpt_every && pos - last_ckpt >= ckpt_every) {
+                BWTProgress g;
+                g.i = i;
+                g.pos = pos;
+                g.pbwtc = pbwtc;
+                g.prev_suf = prev_suf;
+                emit.cut();
+                ckpt_fn(g);
+                last_ckpt = pos;
+            }
             get_word_suflen(gsa[i], wordi, suff_len);
             if (suff_len <= w) continue; // ignore small suffixes
             // full word case
+            group_start = true;
             if (gsa[i] == 0 || dict_idx[gsa[i]-1] == 1) {
-                word_ilist = get_word_ilist(wordi, word_ilist);
-                for (auto j: word_ilist) {
-                    bwtc = bwlast[j];
-                    if (any_sa) {
-                        UPDATE_SA(pbwtc, bwtc, bwsai[j], Difficulty::EASY1);
-                    } else {
-                        UPDATE_BWT(pbwtc, bwtc, Difficulty::EASY1);
-                    }
-                    pbwtc = bwtc;
-                    ++pos;
-                    ++easy_cases;
+                get_word_occs(wordi, word_occs);
+                for (size_t a = 0, b; a < word_occs.size(); a = b) {
+                    for (b = a + 1; b < word_occs.size() && word_occs[b].c == word_occs[a].c; ++b);
+                    emit_occs(i, suff_len, a, b, word_occs[a].c, Difficulty::EASY1);
                 }
             } else { // hard case!
                 // look at all the sufs that share LCP[suf]==this_suffixlen
@@ -134,7 +351,7 @@ class PrefixFreeBWT {
                 words.push_back(wordi);
                 bool same_char = true;
                 size_t j;
-                for (j = i + 1; j < dsize && glcp[j] >= (IntType) suff_len; ++j) {
+                for (j = i + 1; j < gsa.size() && same_suffix(j, suff_len); ++j) {
                     get_word_suflen(gsa[j], nwordi, nsuff_len);
                     if (nsuff_len != suff_len) die("something went wrong!");
                     c = gsa[j]-1 ? dict[gsa[j]-1] : 0;
@@ -143,37 +360,32 @@ class PrefixFreeBWT {
                     same_char = same_char ? (c == pc) : 0;
                     pc = c;
                 } // everything seemingly good up till here.
-                if ((!any_sa && same_char) || (any_sa && (words.size() == 1)) ) {
+                if ((!sorted && same_char) || (sorted && (words.size() == 1)) ) {
                     // print c to bwt after getting all the lengths
                     for (auto word: words)  {
-                        for (auto k: get_word_ilist(word, word_ilist)) {
-                            if (any_sa) {
-                                UPDATE_SA(pbwtc, chars[0], bwsai[k], Difficulty::EASY2);
-                            } else {
-                                UPDATE_BWT(pbwtc, chars[0], Difficulty::EASY2);
-                            }
-                            pbwtc = chars[0];
-                            ++pos;
-                            ++easy_cases;
+                        size_t n;
+                        if (sorted) {
+                            n = get_word_occs(word, word_occs).size();
+                        } else {
+                            auto range = word_ilist_range(word);
+                            n = range.second - range.first;
                         }
+                        emit_occs(i, suff_len, 0, n, chars[0], Difficulty::EASY2);
                     }
                 } else {
                     // TODO: maybe a heap will be better? Like in the original
                     // or it's probably faster to sort ahead of time? IDK, must test
                     for (size_t idx = 0; idx < words.size(); ++idx) {
                         // get ilist of each of these words, make a heap
-                        auto word = words[idx];
-                        for (auto k: get_word_ilist(word, word_ilist)) {
-                            suffs.push_back(SuffixT(chars[idx], k, word));
+                        for (auto o: get_word_occs(words[idx], word_occs)) {
+                            suffs.push_back(SuffixT(chars[idx], o.j, o.sai));
                         }
                     }
+                    hard_groups.add(suffs.size());
                     std::sort(suffs.begin(), suffs.end());
                     for (auto s: suffs) {
-                        if (any_sa) {
-                            UPDATE_SA(pbwtc, s.bwtc, bwsai[s.bwtp], Difficulty::HARD);
-                        } else {
-                            UPDATE_BWT(pbwtc, s.bwtc, Difficulty::HARD);
-                        }
+                        UIntType lcp = row_lcp(gsa[i], suff_len, s.bwtp);
+                        emit.row(pos, pbwtc, s.bwtc, any_sa ? s.sai - suff_len : 0, lcp, Difficulty::HARD);
                         pbwtc = s.bwtc;
                         ++pos;
                         ++hard_cases;
@@ -186,33 +398,157 @@ class PrefixFreeBWT {
             }
         }
         fprintf(stderr, "# easy cases: %lu, # hard cases: %lu\n", easy_cases, hard_cases);
-        fprintf(stderr, "allocations: chars: %lu, words: %lu,  suffs: %lu, word_ilist: %lu\n",
-                chars.capacity(), words.capacity(), suffs.capacity(), word_ilist.capacity());
+        metrics().set("easy_cases", easy_cases);
+        metrics().set("hard_cases", hard_cases);
+        metrics().set("dict_size", dsize);
+        metrics().set("dict_words", dwords);
+        metrics().set("gsa_size", gsa.size());
+        metrics().set("ilist_size", ilist_size());
+        metrics().add_histogram("hard_group_size", hard_groups.counts);
+        fprintf(stderr, "allocations: chars: %lu, words: %lu,  suffs: %lu\n",
+                chars.capacity(), words.capacity(), suffs.capacity());
         fprintf(stderr, "sizes: dict: %lu, bwlast: %lu, ilist: %lu, bwsai: %lu, gsa: %lu, glcp: %lu\n",
                     dict.size(), bwlast.size(), ilist.size(), bwsai.size(), gsa.size(), glcp.size());
         return;
     }
 
+    /* splits the BWT into nslices slices of about the same number of rows,
+     * at gSA group boundaries, w/o generating it. returns where each slice
+     * starts, then where the last one ends (the number of rows in pos). A
+     * slice is generated by starting from its start and stopping at the
+     * next one's i, and its first row always starts a run (pbwtc is 0).
+     * Only depends on the parse, so independent processes agree on it.
+     */
+    std::vector<BWTProgress> split_bwt(size_t nslices) {
+        prepare_dict_suffixes();
+        uint64_t total = 0;
+        scan_groups([&](size_t, uint64_t rows) { total += rows; });
+        std::vector<BWTProgress> v(1);
+        BWTProgress g;
+        scan_groups([&](size_t i, uint64_t rows) {
+            if (v.size() < nslices && g.pos >= total * v.size() / nslices) {
+                g.i = i;
+                v.push_back(g);
+            }
+            g.pos += rows;
+            g.prev_suf = gsa[i];
+        });
+        g.i = gsa.size();
+        v.resize(nslices + 1, g); // empty slices at the end, if groups are too large
+        return v;
+    }
+
+    /* same BWT as generate_bwt_lcp, but delivered as runs of equal chars
+     * (split every max_run rows) w/ their SA values and LCPs, so consumers
+     * can handle whole runs at once. run_fn(const BWTRun&)
+     */
+    template<typename RunFn>
+    void generate_bwt_runs(RunFn run_fn, size_t max_run = 1 << 16) {
+        generate_bwt_runs(run_fn, [](const BWTProgress&) {}, BWTProgress(), 0, max_run);
+    }
+
+    /* w/ checkpoints, as generate_bwt_lcp. runs are cut at checkpoints, so
+     * everything up to g.pos has been delivered when ckpt_fn(g) is called
+     */
+    template<typename RunFn, typename CkptFn>
+    void generate_bwt_runs(RunFn run_fn, CkptFn ckpt_fn, BWTProgress start, uint64_t ckpt_every, size_t max_run = 1 << 16) {
+        RunEmitter<RunFn> emit(run_fn, start.pos, any_sa, text_lcp, max_run);
+        generate_bwt(emit, ckpt_fn, start, ckpt_every, 0);
+        emit.cut();
+    }
+
     // void generate_bwt_fm() {
     //     return;
     // }
 
+    /* removes what save_gsa_checkpoint wrote, once the BWT no longer needs
+     * to be resumed. The files stay readable through open mappings
+     */
+    void remove_gsa_checkpoint() {
+        remove((scratch + "." + EXTGSACKPT).data());
+        remove((scratch + "." + EXTGSA).data());
+        remove((scratch + "." + EXTGLCP).data());
+    }
+
+    /* identifies the dict and the options that determine gSA/gLCP */
+    Checkpoint checkpoint_id() {
+        Checkpoint c;
+        c.set("dsize", dsize);
+        c.set("dwords", dwords);
+        c.set("w", w);
+        c.set("dict_sort", static_cast<uint64_t>(dict_sort));
+        c.set("glcp", build_glcp);
+        c.set("dict_hash", fnv1a(dict.data(), dsize));
+        return c;
+    }
+
     private:
 
+    /* sorts dict suffixes, unless they can be reloaded from a checkpoint */
+    void prepare_dict_suffixes() {
+        if (dict_suffixes_ready) return;
+        dict_suffixes_ready = true;
+        MetricsPhase ph("sort_dict_suffixes");
+        if (resume && load_gsa_checkpoint()) return;
+        sort_dict_suffixes(build_glcp);
+        if (checkpoint) save_gsa_checkpoint();
+    }
+
+    void save_gsa_checkpoint() {
+        if (verbose) fprintf(stderr, "checkpointing gSA and gLCP\n");
+        save_container(gsa, scratch + "." + EXTGSA);
+        if (glcp.size()) save_container(glcp, scratch + "." + EXTGLCP);
+        Checkpoint c(checkpoint_id());
+        c.set("gsa_size", gsa.size());
+        c.set("glcp_size", glcp.size());
+        c.save(scratch + "." + EXTGSACKPT);
+    }
+
+    /* loads gSA (and gLCP) saved by save_gsa_checkpoint, then rebuilds
+     * dict_idx and gsame from them. returns false if there is no checkpoint
+     * or it does not match the current dict and options
+     */
+    bool load_gsa_checkpoint() {
+        Checkpoint c;
+        if (!c.load(scratch + "." + EXTGSACKPT) || !c.matches(checkpoint_id())) {
+            fprintf(stderr, "no usable gSA checkpoint, sorting dict suffixes\n");
+            return false;
+        }
+        gsa = open_placed<WriteConType<UIntType>>(scratch + "." + EXTGSA, placement.gsa);
+        if (c.get("glcp_size"))
+            glcp = open_placed<WriteConType<IntType>>(scratch + "." + EXTGLCP, placement.glcp);
+        if (gsa.size() != c.get("gsa_size") || glcp.size() != c.get("glcp_size"))
+            die("gSA checkpoint files are truncated");
+        fprintf(stderr, "resuming from gSA checkpoint\n");
+        dict_idx = sdsl::bit_vector(dsize, 0);
+        for (size_t i = 0; i < dsize; ++i) {
+            if (dict[i] == EndOfWord) dict_idx[i] = 1;
+        }
+        dict_idx.init_rs();
+        gstart = dict_sort == DictSort::FULL ? dwords+w+1 : 0;
+        if (!glcp.size()) {
+            mark_equal_suffixes(dict, gsa, gstart, gsa.size(), gsame);
+            use_gsame = true;
+        }
+        return true;
+    }
+
     /* run gSACAK on d
-     * populates sa, lcp, and dict_idx;
+     * populates sa, lcp (or gsame), and dict_idx;
      * this is where the bulk of the algorithm takes its time
      */
     void sort_dict_suffixes(bool build_lcp = true) {
         if (dsize < 1) die("error: dictionary not loaded\n");
-        gsa.init_file(fname + "." + EXTGSA, dsize);
-        glcp.init_file(fname + "." + EXTGLCP, dsize);
-        if (build_lcp)
+        if (dict_sort != DictSort::FULL) {
+            sort_dict_suffixes_sparse();
+            return;
+        }
+        gsa.init_file(scratch + "." + EXTGSA, dsize);
+        if (build_lcp) {
+            glcp.init_file(scratch + "." + EXTGLCP, dsize);
             gsacak(&dict[0], &gsa[0], &glcp[0], NULL, dsize);
-        else { // for when memory is low
-            die("non-LCP option not yet implemented");
+        } else { // for when memory is low
             gsacak(&dict[0], &gsa[0], NULL, NULL, dsize);
-            // TODO: build FM index over dict
         }
         // make index of dict end positions
         dict_idx = sdsl::bit_vector(dsize, 0);
@@ -220,6 +556,43 @@ class PrefixFreeBWT {
             dict_idx[gsa[i]] = 1;
         }
         dict_idx.init_rs();
+        gstart = dwords+w+1;
+        // groups of equal suffixes are found by comparing gSA neighbours
+        if (!build_lcp) {
+            mark_equal_suffixes(dict, gsa, gstart, dsize, gsame);
+            use_gsame = true;
+        }
+    }
+
+    /* sort only suffixes w/ length > w. instead of gLCP, gsame marks
+     * suffixes that are equal to the previous one in gSA.
+     * gsa holds no EndOfWord positions here, so dict_idx comes from dict
+     */
+    void sort_dict_suffixes_sparse() {
+        auto init_gsa = [&](size_t s) { gsa.init_file(scratch + "." + EXTGSA, s); };
+        size_t m = dict_sort == DictSort::EXTERNAL
+            ? external_dict_sort<UIntType>(dict, dsize, w, gsa, gsame, init_gsa, scratch, ext_block, verbose)
+            : sparse_dict_sort(dict, dsize, w, gsa, gsame, init_gsa);
+        if (verbose) fprintf(stderr, "sorted %lu of %lu dict suffixes\n", m, dsize);
+        dict_idx = sdsl::bit_vector(dsize, 0);
+        for (size_t i = 0; i < dsize; ++i) {
+            if (dict[i] == EndOfWord) dict_idx[i] = 1;
+        }
+        dict_idx.init_rs();
+        gstart = 0;
+        use_gsame = true;
+    }
+
+    /* LCP of the dict suffixes at a and b, which differ */
+    inline size_t dict_lcp(size_t a, size_t b) const {
+        size_t l = 0;
+        while (dict[a+l] == dict[b+l] && dict[a+l] > EndOfWord) ++l;
+        return l;
+    }
+
+    /* true if gSA[j] spells the same suffix as gSA[j-1] (of length suff_len) */
+    inline bool same_suffix(size_t j, size_t suff_len) const {
+        return use_gsame ? gsame[j] : glcp[j] >= (IntType) suff_len;
     }
 
 
@@ -238,52 +611,137 @@ class PrefixFreeBWT {
         ilist_idx.init_rs();
     }
 
+    MMapPolicy policy(MMapAccess a, bool populate = false) const {
+        MMapPolicy p;
+        p.access = a;
+        p.populate = populate && mmap_populate;
+        p.hugepages = mmap_thp;
+        return p;
+    }
+
+    /* dict, bwlast and bwsai are hit at random (dict through gSA, the others
+     * through ilist values), while ilist (or irecs) is read one word's range
+     * at a time in gSA order, so those ranges are prefetched explicitly
+     */
+    void set_access_policies() {
+        mmap_advise(dict, policy(MMapAccess::RANDOM, true));
+        mmap_advise(bwlast, policy(MMapAccess::RANDOM, true));
+        mmap_advise(bwsai, policy(MMapAccess::RANDOM, true));
+        mmap_advise(ilist, policy(MMapAccess::WINDOW));
+        mmap_advise(irecs, policy(MMapAccess::WINDOW));
+    }
+
+    size_t ilist_size() const {
+        return use_records ? irecs.size() : use_compressed ? cilist.size() : ilist.size();
+    }
+
     size_t get_ilist_size(size_t wordi) const {
         auto startpos = wordi ? ilist_idx.select(wordi) + 1 : 0;
-        auto endpos = wordi >= dwords ? ilist.size()-1 : ilist_idx.select(wordi+1);
+        auto endpos = wordi >= dwords ? ilist_size()-1 : ilist_idx.select(wordi+1);
         return endpos - startpos + 1;
     }
 
-    std::vector<size_t> get_word_ilist(size_t wordi) const {
+    /* calls fn(i, rows) for each group of equal dict suffixes that
+     * generate_bwt_lcp visits, w/ its first gSA index and number of BWT rows
+     */
+    template<typename Fn>
+    void scan_groups(Fn fn) const {
+        size_t next, suff_len, wordi;
+        auto occs = [&](size_t wordi) {
+            auto range = word_ilist_range(wordi);
+            return range.second - range.first;
+        };
+        for (size_t i = gstart; i < gsa.size(); i = next) {
+            next = i + 1;
+            get_word_suflen(gsa[i], wordi, suff_len);
+            if (suff_len <= w) continue;
+            uint64_t rows = occs(wordi);
+            if (gsa[i] != 0 && dict_idx[gsa[i]-1] != 1) { // hard case
+                for (; next < gsa.size() && same_suffix(next, suff_len); ++next) {
+                    rows += occs(dict_idx.rank(gsa[next]));
+                }
+            }
+            fn(i, rows);
+        }
+    }
+
+    /* [first, second) positions in ilist that hold occurrences of word wordi */
+    std::pair<size_t, size_t> word_ilist_range(size_t wordi) const {
         // get to the end of the previous word's list, then add one to get
         // to the start of the current word
         auto startpos = wordi ? ilist_idx.select(wordi) + 1 : 0;
-        auto endpos = wordi >= dwords ? ilist.size()-1 : ilist_idx.select(wordi+1);
-        std::vector<size_t> v;
-        v.reserve(endpos - startpos + 1);
-        for (size_t j = startpos+1; j < endpos+2; ++j)
-            v.push_back(ilist[j]);
-        return v;
+        auto endpos = wordi >= dwords ? ilist_size()-1 : ilist_idx.select(wordi+1);
+        return std::make_pair(startpos+1, endpos+2);
     }
 
-    std::vector<size_t>& get_word_ilist(size_t wordi, std::vector<size_t>& v) const {
-        // get to the end of the previous word's list, then add one to get
-        // to the start of the current word
+    /* fills v w/ the ilist entries of word wordi, along w/ their bwlast char
+     * and bwsai (if needed), from whichever workspace layout is in use
+     */
+    std::vector<IlistRecord<UIntType>>& get_word_occs(size_t wordi, std::vector<IlistRecord<UIntType>>& v) const {
         v.clear();
-        auto startpos = wordi ? ilist_idx.select(wordi) + 1 : 0;
-        auto endpos = wordi >= dwords ? ilist.size()-1 : ilist_idx.select(wordi+1);
-        for (size_t j = startpos+1; j < endpos+2; ++j)
-            v.push_back(ilist[j]);
+        auto range = word_ilist_range(wordi);
+        IlistRecord<UIntType> r;
+        r.sai = 0;
+        if (use_records) {
+            mmap_prefetch(irecs, range.first, range.second - range.first);
+            for (size_t k = range.first; k < range.second; ++k) v.push_back(irecs[k]);
+        } else if (use_compressed) {
+            cilist.decode(wordi+1, range.second - range.first, [&](UIntType j) {
+                r.j = j;
+                r.c = pbwlast[j];
+                if (any_sa) r.sai = bwsai[j];
+                v.push_back(r);
+            });
+        } else {
+            mmap_prefetch(ilist, range.first, range.second - range.first);
+            for (size_t k = range.first; k < range.second; ++k) {
+                r.j = ilist[k];
+                r.c = bwlast[r.j];
+                if (any_sa) r.sai = bwsai[r.j];
+                v.push_back(r);
+            }
+        }
         return v;
     }
 
     std::string fname; // prefix fname for storing and loading relevant files
+    std::string scratch; // prefix for the files of sorting dict suffixes
     size_t w=10; // word size of parser
     bool mmapped = false;
     uint64_t dsize; // number of characters in dict
     uint64_t dwords; // number of words in dict
-    WriteConType<uint8_t> dict; // dict word array (word ends represented by EndOfWord)
+    DictConType<uint8_t> dict; // dict word array (word ends represented by EndOfWord)
     ReadConType<uint8_t> bwlast; // parse-bwt char associated w/ ilist
     ReadConType<UIntType> ilist; // bwlast positions of dict words
     ReadConType<UIntType> bwsai; // TODO: this might need a separate UIntType
+    ReadConType<UIntType> bwlcp; // text LCP of parse suffixes, in parse SA order
+    RangeMin<UIntType> bwlcp_min;
+    ReadConType<IlistRecord<UIntType>> irecs; // ilist w/ bwlast and bwsai, in ilist order
+    DeltaIlist<UIntType> cilist; // compressed ilist
+    PackedBwlast pbwlast; // 2-bit bwlast
     WriteConType<UIntType> gsa; // gSA of dict words
     WriteConType<IntType> glcp; // gLCP of dict words
+    sdsl::bit_vector gsame; // (w/o gLCP) 1 where gSA suffix equals previous one
+    bool use_gsame = false;
+    bool dict_suffixes_ready = false;
+    size_t gstart = 0; // first gSA entry that can contribute to the BWT
     bv_rs<> ilist_idx; // bitvec w/ 1 on ends of dict word occs in ilist
     bv_rs<> dict_idx; // bitvec w/ 1 on word end positions in dict
     bool build_sa = false;
     bool build_rssa = false;
     bool any_sa = false;
+    bool text_lcp = false;
     bool verbose = false;
+    DictSort dict_sort = DictSort::FULL;
+    bool build_glcp = true;
+    size_t ext_block = 1UL << 26;
+    bool use_records = false;
+    bool use_compressed = false;
+    bool mmap_populate = false;
+    bool mmap_thp = false;
+    WorkspacePlacement placement;
+    bool checkpoint = false;
+    bool resume = false;
 };
 }; // namespace end
 #endif
@@ -6,6 +6,7 @@
 #include <sys/stat.h>
 #include "file_wrappers.hpp"
 #include "pfparser.hpp"
+#include "bwt_workspace.hpp"
 extern "C" {
 #include "utils.h"
 #ifndef AC_KSEQ_H
@@ -284,16 +285,25 @@ PfParser<> load_or_generate_parser_w_log(std::string prefix, PfParserParams para
     return parser;
 }
 
-void save_parse_bwt(PfParser<>& parser, std::string output, bool sa = false) {
+void save_parse_bwt(PfParser<>& parser, std::string output, bool sa = false, bool ilist_records = false, bool compressed = false) {
         parser.bwt_of_parse(
                 [&](const std::vector<char>& bwlast,
                     const std::vector<typename PfParser<>::UIntType>& ilist,
                     const std::vector<typename PfParser<>::UIntType>& bwsai)
                 {
+                    if (ilist_records) {
+                        ilist_records_to_file(bwlast, ilist, bwsai, output + "." + EXTILREC);
+                        return;
+                    }
+                    if (compressed) {
+                        compressed_workspace_to_file(bwlast, ilist, parser.get_occs(), output);
+                        if (sa) vec_to_file<typename PfParser<>::UIntType>(bwsai, output + ".bwsai");
+                        return;
+                    }
                     vec_to_file<char>(bwlast, output + ".bwlast");
                     vec_to_file<PfParser<>::UIntType>(ilist, output + ".ilist");
                     if (sa) vec_to_file<typename PfParser<>::UIntType>(bwsai, output + ".bwsai");
-                });
+                }, ilist_records);
 }
 
 } // namespace
@@ -41,6 +41,7 @@ struct PfParserParams {
     bool verbose = false;
     bool trim_non_acgt = false;
     bool non_acgt_to_a = false;
+    bool get_lcp = false; // text LCP of parse suffixes (for the LCP array)
 };
 
 template<typename T>
@@ -376,8 +377,10 @@ struct PfParser {
     }
 
     // generates bwlast and ilist (and bwsai)
+    // if ilist_order, bwlast and bwsai are permuted so that bwlast[k] and
+    // bwsai[k] belong to ilist[k], ie. they can be read in ilist order
     template<typename OutFn>
-    void bwt_of_parse(OutFn out_fn) {
+    void bwt_of_parse(OutFn out_fn, bool ilist_order = false) {
         auto occs = get_occs();
         // these will get passed to out_fn at end
         std::vector<char> bwlast;
@@ -424,6 +427,7 @@ struct PfParser {
         // fprintf(stderr, "Computing S.A. of size %ld over an alphabet of size %ld\n",n+1,k+1);
         int depth = sacak_int(parse_ranks_.data(), SA.data(), n+1, k+1);
         if (depth < 0) die("Error computing SA");
+        if (params_.get_lcp) text_lcp_of_parse(SA, n);
         // if(depth>=0) fprintf(stderr, "S.A. computed with depth: %d\n", depth);
         // else die("Error computing the S.A.");
         // transform S.A. to BWT in place
@@ -463,11 +467,26 @@ struct PfParser {
         // ilist_processor(ilist);
         assert(ilist[0]==1);
         assert(SA[ilist[0]] == 0);
+        if (ilist_order) {
+            std::vector<UIntType>().swap(SA);
+            std::vector<char> pbwlast(n+1);
+            for (size_t k = 0; k < n + 1; ++k) pbwlast[k] = bwlast[ilist[k]];
+            bwlast.swap(pbwlast);
+            std::vector<char>().swap(pbwlast);
+            if (params_.get_sai) {
+                std::vector<UIntType> pbwsai(n+1);
+                for (size_t k = 0; k < n + 1; ++k) pbwsai[k] = bwsai[ilist[k]];
+                bwsai.swap(pbwsai);
+            }
+        }
         out_fn(bwlast, ilist, bwsai);
     }
 
     size_t get_parse_size() const { return parse_ranks_.size(); }
 
+    // set by bwt_of_parse if params.get_lcp, indexed like the parse SA
+    const std::vector<UIntType>& get_bwlcp() const { return bwlcp_; }
+
     const std::vector<UIntType> get_occs() const {
         std::vector<UIntType> occs;
         occs.reserve(sorted_phrases_.size());
@@ -592,6 +611,39 @@ struct PfParser {
         return false;
     }
 
+    /* bwlcp_[i] is the LCP of the text suffixes starting at the phrases of
+     * parse SA rows i-1 and i. Kasai over the parse gives the phrases they
+     * share, each of which adds its length minus the w chars it overlaps the
+     * next one by, and the first pair that differs adds its own LCP (phrases
+     * are prefix-free, so the text LCP ends there)
+     */
+    void text_lcp_of_parse(const std::vector<UIntType>& SA, size_t n) {
+        std::vector<UIntType> plen(sorted_phrases_.size() + 1, 0); // by rank, 0 is EOS
+        for (size_t r = 0; r < sorted_phrases_.size(); ++r) plen[r+1] = strlen(sorted_phrases_[r]);
+        std::vector<UIntType> start(n + 1, 0); // text offset of each phrase
+        for (size_t t = 0; t < n; ++t) start[t+1] = start[t] + plen[parse_ranks_[t]] - params_.w;
+        std::vector<UIntType> rank(n + 1);
+        for (size_t i = 0; i < n + 1; ++i) rank[SA[i]] = i;
+        bwlcp_.assign(n + 1, 0);
+        size_t h = 0;
+        for (size_t t = 0; t < n + 1; ++t) {
+            if (!rank[t]) {
+                h = 0;
+                continue;
+            }
+            size_t u = SA[rank[t] - 1];
+            while (parse_ranks_[t+h] && parse_ranks_[t+h] == parse_ranks_[u+h]) ++h;
+            size_t l = 0;
+            if (parse_ranks_[t+h] && parse_ranks_[u+h]) {
+                const char* a = sorted_phrases_[parse_ranks_[t+h] - 1];
+                const char* b = sorted_phrases_[parse_ranks_[u+h] - 1];
+                while (a[l] && a[l] == b[l]) ++l;
+            }
+            bwlcp_[rank[t]] = start[t+h] - start[t] + l;
+            if (h) --h;
+        }
+    }
+
     void inline process_phrase(const std::string& phrase) {
         auto ret = freqs_.insert({phrase, Freq<UIntType>(1)});
         if (!ret.second) ret.first->second.n += 1;
@@ -607,6 +659,7 @@ struct PfParser {
     std::vector<const char*> sorted_phrases_; // # unique words
     std::vector<char> last_; // # words
     std::vector<UIntType> sai_; // # words
+    std::vector<UIntType> bwlcp_; // # words
     std::vector<UIntType> doc_starts_;
     std::vector<std::string> doc_names_;
     std::vector<ntab_entry> ntab_;
@@ -0,0 +1,108 @@
+#ifndef PHI_HPP
+#define PHI_HPP
+
+/* Author: Taher Mun
+ * phi and inverse phi of the r-index, built from the run-sampled SA that
+ * pfbwt-f64 -r writes (.ssa: row and SA value of each run start, .esa: same
+ * for run ends) and saved ready to be loaded by an index (.phi, .invphi)
+ */
+
+#include <cstdio>
+#include <cinttypes>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include "sdsl/bit_vectors.hpp"
+#include "sdsl/int_vector.hpp"
+#include "sdsl_bv_wrappers.hpp"
+#include "file_wrappers.hpp"
+extern "C" {
+#include "utils.h"
+}
+
+namespace pfbwtf {
+
+/* phi(i) = SA[ISA[i]-1] (or SA[ISA[i]+1] for inverse phi), cyclically.
+ * Text positions of one set of samples are marked in an sd_vector, and for
+ * each one the SA value of the neighbouring BWT row is kept. Since
+ * phi(i) - i is constant between marks, phi(i) = val(j) + (i - j) for the
+ * predecessor j of i among the marks.
+ */
+class PhiSamples {
+
+    public:
+
+    PhiSamples() = default;
+
+    /* samples are (marked text position, phi of it) pairs, in any order;
+     * positions must be < n and include 0
+     */
+    PhiSamples(std::vector<std::pair<uint64_t, uint64_t>> samples, uint64_t n) {
+        std::sort(samples.begin(), samples.end());
+        if (!samples.size() || samples[0].first) die("phi samples must include text position 0");
+        sdsl::sd_vector_builder b(n, samples.size());
+        vals_ = sdsl::int_vector<>(samples.size(), 0, sdsl::bits::hi(n) + 1);
+        for (size_t k = 0; k < samples.size(); ++k) {
+            b.set(samples[k].first);
+            vals_[k] = samples[k].second;
+        }
+        marks_ = bv_rs<sdsl::sd_vector<>>(sdsl::sd_vector<>(b));
+    }
+
+    PhiSamples(std::string fname) {
+        std::ifstream in(fname, std::ios::binary);
+        if (!in) {
+            fprintf(stderr, "PhiSamples: error opening %s\n", fname.data());
+            exit(1);
+        }
+        marks_.load(in);
+        vals_.load(in);
+    }
+
+    void save(std::string fname) const {
+        std::ofstream out(fname, std::ios::binary);
+        marks_.serialize(out);
+        vals_.serialize(out);
+        if (!out) die("could not write phi samples");
+    }
+
+    uint64_t operator()(uint64_t i) const {
+        size_t k = marks_.rank(i + 1); // marks <= i, there is always one at 0
+        uint64_t j = marks_.select(k);
+        return vals_[k - 1] + (i - j);
+    }
+
+    size_t size() const { return vals_.size(); }
+
+    private:
+
+    bv_rs<sdsl::sd_vector<>> marks_;
+    sdsl::int_vector<> vals_;
+};
+
+/* builds phi and inverse phi from <prefix>.ssa and <prefix>.esa, and saves
+ * them to <prefix>.phi and <prefix>.invphi. The run starting a BWT row k
+ * follows the run ending at row k-1 (and row 0 follows the last row), so the
+ * k-th run start's SA value maps to the (k-1)-th run end's under phi, and
+ * vice versa under inverse phi. Returns the number of runs.
+ */
+template<typename UIntType>
+size_t build_phi(std::string prefix) {
+    // pairs of (BWT row, SA value)
+    VecFileSource<UIntType> ssa(prefix + "." + EXTSSA);
+    VecFileSource<UIntType> esa(prefix + "." + EXTESA);
+    size_t r = ssa.size() / 2;
+    if (!r || esa.size() != ssa.size()) die("run-sampled SA files do not match");
+    uint64_t n = ssa[1] + 1; // row 0 is the suffix at the terminator
+    std::vector<std::pair<uint64_t, uint64_t>> s(r);
+    for (size_t k = 0; k < r; ++k) s[k] = {ssa[2*k+1], esa[2*((k+r-1)%r)+1]};
+    PhiSamples(std::move(s), n).save(prefix + "." + EXTPHI);
+    s.resize(r);
+    for (size_t k = 0; k < r; ++k) s[k] = {esa[2*k+1], ssa[2*((k+1)%r)+1]};
+    PhiSamples(std::move(s), n).save(prefix + "." + EXTINVPHI);
+    return r;
+}
+
+}; // namespace end
+#endif
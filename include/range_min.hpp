@@ -0,0 +1,66 @@
+#ifndef RANGE_MIN_HPP
+#define RANGE_MIN_HPP
+
+/* Author: Taher Mun
+ * range minimum queries over an array that stays in its own container (so
+ * it can be mmap'd). Minima of blocks of 64 entries are kept in a sparse
+ * table: a query scans at most two partial blocks and does two table
+ * lookups, and the table takes ~(n/64) log(n/64) words.
+ */
+
+#include <cinttypes>
+#include <vector>
+#include <algorithm>
+
+namespace pfbwtf {
+
+template<typename T>
+class RangeMin {
+
+    public:
+
+    static constexpr size_t B = 64;
+
+    RangeMin() {}
+
+    template<typename C>
+    RangeMin(const C& a) {
+        size_t nb = (a.size() + B - 1) / B;
+        if (!nb) return;
+        table_.emplace_back(nb);
+        for (size_t b = 0; b < nb; ++b) {
+            T m = a[b * B];
+            for (size_t i = b * B + 1; i < std::min(a.size(), (b + 1) * B); ++i) m = std::min<T>(m, a[i]);
+            table_[0][b] = m;
+        }
+        for (size_t k = 1; (1UL << k) <= nb; ++k) {
+            const auto& prev = table_[k-1];
+            std::vector<T> cur(nb - (1UL << k) + 1);
+            for (size_t b = 0; b < cur.size(); ++b) cur[b] = std::min(prev[b], prev[b + (1UL << (k-1))]);
+            table_.push_back(std::move(cur));
+        }
+    }
+
+    /* min of a[l..r], l <= r */
+    template<typename C>
+    T query(const C& a, size_t l, size_t r) const {
+        size_t lb = l / B, rb = r / B;
+        T m = a[l];
+        if (lb == rb || lb + 1 == rb) {
+            for (size_t i = l + 1; i <= r; ++i) m = std::min<T>(m, a[i]);
+            return m;
+        }
+        for (size_t i = l + 1; i < (lb + 1) * B; ++i) m = std::min<T>(m, a[i]);
+        for (size_t i = rb * B; i <= r; ++i) m = std::min<T>(m, a[i]);
+        size_t k = 63 - __builtin_clzll(rb - lb - 1);
+        m = std::min(m, std::min(table_[k][lb + 1], table_[k][rb - (1UL << k)]));
+        return m;
+    }
+
+    private:
+
+    std::vector<std::vector<T>> table_;
+};
+
+}; // namespace end
+#endif
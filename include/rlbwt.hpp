@@ -0,0 +1,180 @@
+#ifndef RLBWT_HPP
+#define RLBWT_HPP
+
+/* Author: Taher Mun
+ * run-length encoded BWT, in the layout used by PFP-based r-index tools:
+ * <prefix>.bwt.heads holds the char of each run, <prefix>.bwt.len its length
+ * as an IBYTES-byte little-endian integer (see write_myint). Runs longer
+ * than 2^(8*IBYTES)-1 are split.
+ * RLBWT loads it back (or run-length encodes a packed or plain .bwt) w/
+ * rank and LF support for backward search.
+ */
+
+#include <cstdio>
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sys/stat.h>
+#include "file_wrappers.hpp"
+#include "out_stream.hpp"
+#include "packed_bwt.hpp"
+#include "segments.hpp"
+extern "C" {
+#include "utils.h"
+}
+
+namespace pfbwtf {
+
+class RLBWTWriter {
+
+    public:
+
+    static constexpr uint64_t max_len = (1ULL << (8 * IBYTES)) - 1;
+
+    RLBWTWriter() {}
+
+    RLBWTWriter(OutStream* heads, OutStream* lens) : heads_(heads), lens_(lens) {}
+
+    void push(uint8_t c) {
+        if (len && c == head && len < max_len) {
+            ++len;
+            return;
+        }
+        flush_run();
+        head = c;
+        len = 1;
+    }
+
+    /* writes the last run. call once all chars are pushed */
+    void finish() {
+        flush_run();
+        len = 0;
+    }
+
+    // the current (unwritten) run, saved/restored by checkpoints
+    uint8_t head = 0;
+    uint64_t len = 0;
+
+    private:
+
+    void flush_run() {
+        if (!len) return;
+        heads_->put(head);
+        lens_->write(&len, IBYTES); // little-endian, as write_myint
+    }
+
+    OutStream* heads_ = NULL;
+    OutStream* lens_ = NULL;
+};
+
+/* RLBWT w/ rank over the run heads: for each char, the indices of its runs
+ * and the prefix sums of their lengths, so rank and LF take a binary search
+ * over the run starts and one over the char's runs. O(r) words of memory.
+ */
+class RLBWT {
+
+    public:
+
+    RLBWT() {}
+
+    /* loads <prefix>.bwt.heads and <prefix>.bwt.len if present, otherwise
+     * run-length encodes <prefix>.bwt.2bit (see packed_bwt.hpp) or <prefix>.bwt
+     * (which may be segmented, see segments.hpp) */
+    RLBWT(std::string prefix) {
+        for (auto& v: cum_) v.push_back(0);
+        struct stat st;
+        std::string heads_fname = prefix + "." + EXTRLHDS;
+        if (!stat(heads_fname.data(), &st)) {
+            VecFileSource<uint8_t> heads(heads_fname);
+            VecFileSource<uint8_t> lens(prefix + "." + EXTRLLEN);
+            if (lens.size() != heads.size() * IBYTES) die("RLBWT heads and lengths do not match");
+            for (size_t k = 0; k < heads.size(); ++k) {
+                uint64_t len = 0; // little-endian, as in write_myint
+                for (size_t j = 0; j < IBYTES; ++j) len |= uint64_t(lens[k * IBYTES + j]) << (8 * j);
+                add_run(heads[k], len);
+            }
+        } else {
+            uint64_t len = 0;
+            uint8_t c = 0;
+            auto push = [&](uint8_t x) {
+                if (len && x != c) {
+                    add_run(c, len);
+                    len = 0;
+                }
+                c = x;
+                ++len;
+            };
+            if (!stat((prefix + "." + EXTPKBWT).data(), &st)) {
+                PackedBWT(prefix).scan(push);
+            } else if (auto segs = read_segment_index(prefix, "bwt"); segs.size()) {
+                mFile* f = mopen_aux_file(prefix.data(), "bwt", segs.size());
+                std::vector<uint8_t> buf(1 << 20);
+                size_t k;
+                while ((k = mfread(buf.data(), 1, buf.size(), f))) {
+                    for (size_t i = 0; i < k; ++i) push(buf[i]);
+                }
+                mfclose(f);
+            } else {
+                MMapFileSource<uint8_t> bwt(prefix + ".bwt");
+                for (size_t i = 0; i < bwt.size(); ++i) push(bwt[i]);
+            }
+            if (len) add_run(c, len);
+        }
+        starts_.push_back(n_);
+        uint64_t s = 0;
+        for (size_t c = 0; c < 256; ++c) {
+            C_[c] = s;
+            s += cum_[c].back();
+        }
+        C_[256] = s;
+    }
+
+    uint64_t size() const { return n_; }
+    size_t runs() const { return heads_.size(); }
+
+    // run containing BWT row i
+    size_t run_of(uint64_t i) const {
+        return std::upper_bound(starts_.begin(), starts_.end(), i) - starts_.begin() - 1;
+    }
+
+    uint8_t head(size_t k) const { return heads_[k]; }
+    uint8_t operator[](uint64_t i) const { return heads_[run_of(i)]; }
+
+    // occurrences of c in BWT[0, i)
+    uint64_t rank(uint8_t c, uint64_t i) const {
+        size_t k = run_of(i);
+        size_t j = std::lower_bound(runs_[c].begin(), runs_[c].end(), k) - runs_[c].begin();
+        uint64_t r = cum_[c][j];
+        if (k < heads_.size() && heads_[k] == c) r += i - starts_[k];
+        return r;
+    }
+
+    // last run of c before run k, or runs() if there is none
+    size_t pred_run(uint8_t c, size_t k) const {
+        size_t j = std::lower_bound(runs_[c].begin(), runs_[c].end(), k) - runs_[c].begin();
+        return j ? runs_[c][j - 1] : heads_.size();
+    }
+
+    uint64_t LF(uint8_t c, uint64_t i) const { return C_[c] + rank(c, i); }
+
+    private:
+
+    void add_run(uint8_t c, uint64_t len) {
+        runs_[c].push_back(heads_.size());
+        cum_[c].push_back(cum_[c].back() + len);
+        heads_.push_back(c);
+        starts_.push_back(n_);
+        n_ += len;
+    }
+
+    uint64_t n_ = 0;
+    std::vector<uint8_t> heads_;
+    std::vector<uint64_t> starts_;
+    std::vector<uint64_t> runs_[256];
+    std::vector<uint64_t> cum_[256];
+    uint64_t C_[257];
+};
+
+}; // namespace end
+#endif
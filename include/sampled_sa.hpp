@@ -0,0 +1,62 @@
+#ifndef SAMPLED_SA_HPP
+#define SAMPLED_SA_HPP
+
+/* Author: Taher Mun
+ * regularly sampled SA, as used for FM-index locate, written by
+ * pfbwt-f64 --sa-sample-rate k:
+ *   .smpsa     SA values that are multiples of k, in BWT order
+ *   .smpsa.bv  sdsl::bit_vector marking the BWT rows of those values
+ *   .smpisa    ISA at text positions 0, k, 2k, ... (inverse SA samples)
+ * The bit vector is streamed in sdsl's serialization layout (size in bits,
+ * then 64-bit words), so it loads w/ sdsl::load_from_file.
+ */
+
+#include <cstdio>
+#include <cinttypes>
+#include "out_stream.hpp"
+extern "C" {
+#include "utils.h"
+}
+
+namespace pfbwtf {
+
+class BitVectorWriter {
+
+    public:
+
+    BitVectorWriter() {}
+
+    BitVectorWriter(OutStream* out) : out_(out) {}
+
+    /* size of the bit vector in bits. call before any push, unless resuming */
+    void write_header(uint64_t size) {
+        out_->put(size);
+    }
+
+    void push(bool b) {
+        word |= uint64_t(b) << bits;
+        if (++bits == 64) flush_word();
+    }
+
+    /* writes the last, partial word. call once all bits are pushed */
+    void finish() {
+        if (bits) flush_word();
+    }
+
+    // the current (unwritten) word, saved/restored by checkpoints
+    uint64_t word = 0;
+    uint64_t bits = 0;
+
+    private:
+
+    void flush_word() {
+        out_->put(word);
+        word = 0;
+        bits = 0;
+    }
+
+    OutStream* out_ = NULL;
+};
+
+}; // namespace end
+#endif
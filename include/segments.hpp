@@ -0,0 +1,81 @@
+#ifndef SEGMENTS_HPP
+#define SEGMENTS_HPP
+
+/* Author: Taher Mun
+ * outputs split into numbered segments (pfbwt-f64 --segment-size, mps_to_ma
+ * on a segmented SA). Segment k of <base>.<ext> is <base>.<k>.<ext>, as
+ * named by open_aux_file_num, so mopen_aux_file/mfread read them back as
+ * one stream. <base>.<ext>.segs lists the segments, one per line: file name
+ * (w/o directory), offset in the whole output and size, in bytes.
+ * Concatenating the segments in order gives the unsegmented file, and
+ * readers can also process them in parallel.
+ */
+
+#include <cstdio>
+#include <cinttypes>
+#include <string>
+#include <vector>
+extern "C" {
+#include "utils.h"
+}
+
+namespace pfbwtf {
+
+struct Segment {
+    std::string fname; // incl. the directory of base
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+inline std::string segment_fname(std::string base, std::string ext, size_t k) {
+    return base + "." + std::to_string(k) + "." + ext;
+}
+
+inline std::string segment_index_fname(std::string base, std::string ext) {
+    return base + "." + ext + ".segs";
+}
+
+/* splits a file name into base and ext at its last '.' */
+inline std::pair<std::string, std::string> split_ext(std::string fname) {
+    size_t dot = fname.rfind('.');
+    size_t slash = fname.rfind('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return {fname, ""};
+    return {fname.substr(0, dot), fname.substr(dot + 1)};
+}
+
+/* bytes: size of each segment, in order */
+inline void write_segment_index(std::string base, std::string ext, const std::vector<uint64_t>& bytes) {
+    std::string fname = segment_index_fname(base, ext);
+    FILE* fp = fopen(fname.data(), "w");
+    if (fp == NULL) die(fname.data());
+    size_t slash = base.rfind('/');
+    uint64_t offset = 0;
+    for (size_t k = 0; k < bytes.size(); ++k) {
+        std::string name = segment_fname(base, ext, k);
+        if (slash != std::string::npos) name = name.substr(slash + 1);
+        fprintf(fp, "%s\t%" PRIu64 "\t%" PRIu64 "\n", name.data(), offset, bytes[k]);
+        offset += bytes[k];
+    }
+    if (fclose(fp)) die(fname.data());
+}
+
+/* the segments of <base>.<ext>, or none if it is not segmented */
+inline std::vector<Segment> read_segment_index(std::string base, std::string ext) {
+    std::vector<Segment> segs;
+    FILE* fp = fopen(segment_index_fname(base, ext).data(), "r");
+    if (fp == NULL) return segs;
+    size_t slash = base.rfind('/');
+    std::string dir = slash == std::string::npos ? "" : base.substr(0, slash + 1);
+    char name[4096];
+    Segment s;
+    while (fscanf(fp, "%4095s %" SCNu64 " %" SCNu64, name, &s.offset, &s.bytes) == 3) {
+        s.fname = dir + name;
+        segs.push_back(s);
+    }
+    fclose(fp);
+    if (segs.empty()) die("empty segment index");
+    return segs;
+}
+
+}; // namespace end
+#endif
@@ -0,0 +1,73 @@
+#ifndef THRESHOLDS_HPP
+#define THRESHOLDS_HPP
+
+/* Author: Taher Mun
+ * matching statistics thresholds (as in MONI): for each BWT run of char c,
+ * the row of the minimum LCP between the end of the previous run of c and
+ * the start of this one (0 for the first run of c). Computed from the rows
+ * as they are output, keeping the running minimum since the last c for
+ * every char seen so far.
+ */
+
+#include <cinttypes>
+#include <vector>
+#include <string>
+#include "checkpoint.hpp"
+
+namespace pfbwtf {
+
+class Thresholds {
+
+    public:
+
+    Thresholds() {}
+
+    /* row i has char c and LCP l w/ row i-1. returns the threshold of row
+     * i, which is only meaningful if row i starts a run */
+    uint64_t push(uint8_t c, uint64_t l, uint64_t i) {
+        bool first = !seen_[c];
+        if (first) {
+            seen_[c] = true;
+            chars_.push_back(c);
+            min_[c] = NONE;
+        }
+        for (auto d: chars_) {
+            if (l < min_[d]) {
+                min_[d] = l;
+                row_[d] = i;
+            }
+        }
+        uint64_t thr = first ? 0 : row_[c];
+        min_[c] = NONE;
+        return thr;
+    }
+
+    void save(Checkpoint& ckpt) const {
+        for (auto c: chars_) {
+            ckpt.set("thr_min_" + std::to_string(c), min_[c]);
+            ckpt.set("thr_row_" + std::to_string(c), row_[c]);
+        }
+    }
+
+    void load(const Checkpoint& ckpt) {
+        for (size_t c = 0; c < 256; ++c) {
+            std::string k = std::to_string(c);
+            if (!ckpt.has("thr_min_" + k)) continue;
+            seen_[c] = true;
+            chars_.push_back(c);
+            min_[c] = ckpt.get("thr_min_" + k);
+            row_[c] = ckpt.get("thr_row_" + k);
+        }
+    }
+
+    private:
+
+    static constexpr uint64_t NONE = UINT64_MAX;
+    bool seen_[256] = {};
+    std::vector<uint8_t> chars_;
+    uint64_t min_[256];
+    uint64_t row_[256];
+};
+
+}; // namespace end
+#endif
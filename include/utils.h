@@ -23,12 +23,35 @@
 #define EXTBWLST "bwlast"
 #define EXTSAI   "sai"
 #define EXTBWSAI "bwsai"
+#define EXTBWLCP "bwlcp"
 #define EXTILIST "ilist"
+#define EXTILREC "ilrec"
+#define EXTCILIST "cilist"
+#define EXTPBWLST "pbwlast"
 #define EXTSA    "sa"
 #define EXTSSA   "ssa"
 #define EXTESA   "esa"
 #define EXTGSA   "gsa"
 #define EXTGLCP  "glcp"
+#define EXTRLHDS "bwt.heads"
+#define EXTRLLEN "bwt.len"
+#define EXTPKBWT "bwt.2bit"
+#define EXTPKEXC "bwt.exc"
+#define EXTPHI   "phi"
+#define EXTINVPHI "invphi"
+#define EXTDA    "da"
+#define EXTSDA   "sda"
+#define EXTEDA   "eda"
+#define EXTLCP   "lcp"
+#define EXTRLCP  "rlcp"
+#define EXTTHR   "thr"
+#define EXTSMPSA  "smpsa"
+#define EXTSMPBV  "smpsa.bv"
+#define EXTSMPISA "smpisa"
+#define EXTPRSCKPT "parse.ckpt"
+#define EXTGSACKPT "gsa.ckpt"
+#define EXTBWTCKPT "bwt.ckpt"
+#define EXTMRGCKPT "merge.ckpt"
 
 
 void die(const char *s);
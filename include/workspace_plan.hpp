@@ -0,0 +1,92 @@
+#ifndef WORKSPACE_PLAN_HPP
+#define WORKSPACE_PLAN_HPP
+
+/* Author: Taher Mun
+ * memory-budget planner for PrefixFreeBWT: estimates the size of each
+ * workspace array from the parse and decides which ones stay in RAM and which
+ * ones are mmap'd (see PlacedFile)
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "pfbwt.hpp"
+#include "file_wrappers.hpp"
+extern "C" {
+#include "utils.h"
+}
+
+namespace pfbwtf {
+
+struct ArrayEstimate {
+    const char* name;
+    size_t bytes;
+    bool* mapped; // NULL if the array can't be placed (always in RAM)
+};
+
+/* estimated sizes (in bytes) of the arrays PrefixFreeBWT will hold for p,
+ * in the order they should be kept in RAM: randomly accessed arrays first
+ * (dict through gSA, bwlast/bwsai through ilist values), then gsa (random
+ * while being sorted), then the arrays that are only scanned.
+ * sizes come from .occ (number of parse words) and the dict size.
+ */
+std::vector<ArrayEstimate> estimate_workspace(PrefixFreeBWTParams& p) {
+    std::vector<ArrayEstimate> est;
+    size_t dsize = get_file_size_((p.prefix + "." + EXTDICT).data());
+    uint64_t nwords = 0;
+    {
+        VecFileSource<uint_t> occs(p.prefix + "." + EXTOCC);
+        for (size_t i = 0; i < occs.size(); ++i) nwords += occs[i];
+    }
+    size_t nilist = nwords + 1; // ilist[0] is the end of the parse
+    bool any_sa = p.sa || p.rssa;
+    bool lcp = p.dict_sort == DictSort::FULL && p.glcp;
+    WorkspacePlacement& pl = p.placement;
+    est.push_back({"dict", dsize, &pl.dict});
+    if (p.compressed) {
+        est.push_back({"cilist+pbwlast",
+                get_file_size_((p.prefix + "." + EXTCILIST).data()) +
+                get_file_size_((p.prefix + "." + EXTPBWLST).data()), NULL});
+    } else if (!p.ilist_records) {
+        est.push_back({"bwlast", nilist, &pl.bwlast});
+    }
+    if (any_sa && !p.ilist_records) est.push_back({"bwsai", nilist * sizeof(uint_t), &pl.bwsai});
+    if (p.lcp) est.push_back({"bwlcp", nilist * sizeof(uint_t), &pl.bwlcp});
+    // upper bound for SPARSE and EXTERNAL, which only keep suffixes longer than w
+    est.push_back({"gsa", dsize * sizeof(uint_t), &pl.gsa});
+    if (lcp) est.push_back({"glcp", dsize * sizeof(int_t), &pl.glcp});
+    if (p.ilist_records) {
+        est.push_back({"ilrec", nilist * sizeof(IlistRecord<uint_t>), &pl.ilist});
+    } else if (!p.compressed) {
+        est.push_back({"ilist", nilist * sizeof(uint_t), &pl.ilist});
+    }
+    // rank/select bit vectors (ilist_idx, dict_idx, gsame), w/ ~25% support overhead
+    est.push_back({"bitvectors", (nwords + (lcp ? 1 : 2) * dsize) / 8 * 5 / 4, NULL});
+    return est;
+}
+
+/* greedily keeps arrays in RAM, in estimate_workspace order, while the total
+ * stays within max_mem bytes; the rest are mmap'd. Fills p.placement and
+ * returns the predicted peak RAM usage of the workspace.
+ */
+size_t plan_workspace(PrefixFreeBWTParams& p, size_t max_mem) {
+    auto est = estimate_workspace(p);
+    size_t peak = 0;
+    for (auto& a: est) if (a.mapped == NULL) peak += a.bytes;
+    for (auto& a: est) {
+        if (a.mapped == NULL) continue;
+        *a.mapped = peak + a.bytes > max_mem;
+        if (!*a.mapped) peak += a.bytes;
+    }
+    fprintf(stderr, "workspace plan (max %.1f MB):\n", max_mem / 1048576.0);
+    for (auto& a: est) {
+        fprintf(stderr, "\t%-16s%12.1f MB\t%s\n", a.name, a.bytes / 1048576.0,
+                a.mapped && *a.mapped ? "mmap" : "RAM");
+    }
+    fprintf(stderr, "predicted peak: %.1f MB\n", peak / 1048576.0);
+    if (peak > max_mem) fprintf(stderr, "warning: arrays that can't be mmap'd already exceed --max-mem\n");
+    return peak;
+}
+
+}; // namespace end
+#endif
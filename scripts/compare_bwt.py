@@ -0,0 +1,152 @@
+"""
+runs pfbwt-f64, simplebwt (direct SACA) and optionally the original Big-BWT
+on the same synthetic inputs (from sim_pangenome), checks that their BWTs and
+SAs are identical, and reports speedup and memory ratios vs. simplebwt as a
+function of input size and repetitiveness, along with the smallest size at
+which pfbwt-f64 beats simplebwt.
+"""
+import sys
+import os
+import time
+import argparse
+import filecmp
+import subprocess
+
+
+def run(cmd, log):
+    """ runs cmd, returns (wall seconds, peak RSS in bytes). The peak RSS of
+    tiny runs is that of this script, which the child inherits at fork """
+    sys.stderr.write("running: {}\n".format(" ".join(cmd)))
+    with open(log, "w") as log_fp:
+        start = time.perf_counter()
+        p = subprocess.Popen(cmd, stdout=log_fp, stderr=subprocess.STDOUT)
+        _, status, ru = os.wait4(p.pid, 0)
+        wall = time.perf_counter() - start
+    p.returncode = os.waitstatus_to_exitcode(status)
+    if p.returncode != 0:
+        sys.stderr.write("{} failed, see {}\n".format(cmd[0], log))
+        sys.exit(1)
+    return wall, ru.ru_maxrss * 1024
+
+
+def fasta_to_text(fasta, text, w):
+    """ writes the text pfbwt-f64 builds from fasta: each sequence, uppercased,
+    followed by w As """
+    n = 0
+    with open(fasta, "r") as fa, open(text, "w") as out:
+        first = True
+        for line in fa:
+            if line[0] == '>':
+                if not first:
+                    out.write("A" * w)
+                    n += w
+                first = False
+            else:
+                s = line.strip().upper()
+                out.write(s)
+                n += len(s)
+        if not first:
+            out.write("A" * w)
+            n += w
+    return n
+
+
+def sa_equal(fname1, fname2, n):
+    """ compares SAs of n entries stored w/ any number of bytes per entry
+    (eg. 8 for pfbwt-f64 and simplebwt, 5 for Big-BWT) """
+    b1 = os.path.getsize(fname1) // n
+    b2 = os.path.getsize(fname2) // n
+    if b1 == b2:
+        return filecmp.cmp(fname1, fname2, shallow=False)
+    chunk = 1 << 20
+    with open(fname1, "rb") as f1, open(fname2, "rb") as f2:
+        while True:
+            x1 = widen(f1.read(chunk * b1), b1)
+            x2 = widen(f2.read(chunk * b2), b2)
+            if x1 != x2:
+                return False
+            if not x1:
+                return True
+
+
+def widen(buf, b):
+    """ little-endian entries of b bytes to entries of 8 bytes """
+    if b == 8:
+        return bytes(buf)
+    k = len(buf) // b
+    out = bytearray(8 * k)
+    for j in range(b):
+        out[j::8] = buf[j::b]
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("-s", "--sizes", default="1,4,16", help="comma separated input sizes in Mbp")
+    parser.add_argument("-d", "--snp-rates", default="0.001,0.01,0.1", help="comma separated SNP rates (lower is more repetitive)")
+    parser.add_argument("-H", "--haplotypes", default=8, type=int, help="haplotypes per input")
+    parser.add_argument("-w", default=10, type=int, help="window size")
+    parser.add_argument("-p", default=100, type=int, help="modulo for parsing")
+    parser.add_argument("--bin-dir", default=".", help="directory w/ pfbwt-f64, simplebwt and sim_pangenome")
+    parser.add_argument("--bigbwt", default=None, help="path to Big-BWT's bigbwt, to include it in the comparison")
+    parser.add_argument("--tmp", default=".", help="directory for inputs and outputs")
+    parser.add_argument("--keep", action="store_true", help="keep inputs and outputs")
+    parser.add_argument("-o", "--output", default=None, help="write results (TSV) to this file instead of stdout")
+    args = parser.parse_args()
+
+    out = open(args.output, "w") if args.output else sys.stdout
+    out.write("size\thaplotypes\tsnp_rate\tn\ttool\twall_s\tpeak_rss_mb\tspeedup\tmem_ratio\tidentical\n")
+    sizes = sorted(float(x) for x in args.sizes.split(","))
+    rates = [float(x) for x in args.snp_rates.split(",")]
+    crossover = {}
+    mismatch = False
+    for size in sizes:
+        for rate in rates:
+            prefix = os.path.join(args.tmp, "compare_bwt.{}M.{}".format(size, rate))
+            # the reference is written along w/ the haplotypes
+            l = max(1, int(size * 1e6 / (args.haplotypes + 1)))
+            run([os.path.join(args.bin_dir, "sim_pangenome"), "-o", prefix, "-l", str(l),
+                 "-H", str(args.haplotypes), "-d", str(rate), "-i", str(rate / 10)], prefix + ".sim.log")
+            n = fasta_to_text(prefix + ".fa", prefix + ".txt", args.w) + 1 # incl. terminator
+            results = {}
+            results["simplebwt"] = run([os.path.join(args.bin_dir, "simplebwt"), "-s", prefix + ".txt"], prefix + ".simplebwt.log")
+            outputs = {"simplebwt": (prefix + ".txt.Bwt", prefix + ".txt.sa")}
+            results["pfbwt-f64"] = run([os.path.join(args.bin_dir, "pfbwt-f64"), "-s", "-w", str(args.w), "-p", str(args.p),
+                                        "-o", prefix + ".pfbwt", prefix + ".fa"], prefix + ".pfbwt.log")
+            outputs["pfbwt-f64"] = (prefix + ".pfbwt.bwt", prefix + ".pfbwt.sa")
+            if args.bigbwt:
+                results["bigbwt"] = run([args.bigbwt, "-S", "-w", str(args.w), "-p", str(args.p), prefix + ".txt"], prefix + ".bigbwt.log")
+                outputs["bigbwt"] = (prefix + ".txt.bwt", prefix + ".txt.sa")
+            base_wall, base_rss = results["simplebwt"]
+            for tool, (wall, rss) in results.items():
+                if tool == "simplebwt":
+                    same = "-"
+                else:
+                    same = filecmp.cmp(outputs[tool][0], outputs["simplebwt"][0], shallow=False) and \
+                           sa_equal(outputs[tool][1], outputs["simplebwt"][1], n)
+                    mismatch = mismatch or not same
+                    same = "yes" if same else "no"
+                out.write("{}\t{}\t{}\t{}\t{}\t{:.3f}\t{:.1f}\t{:.3f}\t{:.3f}\t{}\n".format(
+                    size, args.haplotypes, rate, n, tool, wall, rss / 1048576,
+                    base_wall / wall if wall > 0 else 0, rss / base_rss, same))
+            out.flush()
+            if results["pfbwt-f64"][0] < base_wall and rate not in crossover:
+                crossover[rate] = size
+            if not args.keep:
+                for f in os.listdir(args.tmp or "."):
+                    if f.startswith(os.path.basename(prefix) + "."):
+                        os.remove(os.path.join(args.tmp, f))
+    for rate in rates:
+        if rate in crossover:
+            out.write("# snp_rate {}: pfbwt-f64 is faster than simplebwt from {} Mbp\n".format(rate, crossover[rate]))
+        else:
+            out.write("# snp_rate {}: pfbwt-f64 is not faster than simplebwt at the sizes tested\n".format(rate))
+    if out != sys.stdout:
+        out.close()
+    if mismatch:
+        sys.stderr.write("error: outputs differ, see the identical column\n")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
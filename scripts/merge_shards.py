@@ -0,0 +1,64 @@
+import os
+import sys
+import argparse
+
+# plain concatenation, as rows are in order and values are absolute
+CONCAT_EXTS = ["bwt", "sa", "lcp", "da"]
+RUN_BYTES = 16 # (row, SA) pair of uint64s in .ssa/.esa
+
+def copy_range(src, start, end, out, bufsize=1 << 24):
+    with open(src, "rb") as f:
+        f.seek(start)
+        left = end - start
+        while left:
+            b = f.read(min(bufsize, left))
+            if not b:
+                raise IOError("{} is truncated".format(src))
+            out.write(b)
+            left -= len(b)
+
+def bwt_char(fname, i):
+    with open(fname, "rb") as f:
+        f.seek(i)
+        return f.read(1)
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="joins the slices written by pfbwt-f64 --pfbwt-only --shard <i>/<N> into <prefix>.<ext>")
+    parser.add_argument("prefix", help="-o of pfbwt-f64")
+    parser.add_argument("shards", type=int, help="N")
+    parser.add_argument("--remove", action="store_true", help="delete the shard files once joined")
+    args = parser.parse_args()
+
+    shards = ["{}.shard{}".format(args.prefix, i) for i in range(args.shards)]
+    exts = [e for e in CONCAT_EXTS + ["ssa", "esa"] if os.path.exists("{}.{}".format(shards[0], e))]
+    for s in shards:
+        for e in exts + ["bwt"]:
+            if not os.path.exists("{}.{}".format(s, e)):
+                sys.stderr.write("missing {}.{}\n".format(s, e))
+                sys.exit(1)
+    # each shard starts and ends a run at its edges. where the BWT chars
+    # across an edge are equal, that run continues: drop its end from .esa
+    # of the shard before and its start from .ssa of the shard after
+    sizes = [os.path.getsize(s + ".bwt") for s in shards]
+    nonempty = [k for k in range(len(shards)) if sizes[k]]
+    joined_end = set() # shards whose last run continues in the next nonempty one
+    for a, b in zip(nonempty, nonempty[1:]):
+        if bwt_char(shards[a] + ".bwt", sizes[a] - 1) == bwt_char(shards[b] + ".bwt", 0):
+            joined_end.add(a)
+    joined_start = set(b for a, b in zip(nonempty, nonempty[1:]) if a in joined_end)
+    for e in exts:
+        with open("{}.{}".format(args.prefix, e), "wb") as out:
+            for k, s in enumerate(shards):
+                fname = "{}.{}".format(s, e)
+                start, end = 0, os.path.getsize(fname)
+                if e == "ssa" and k in joined_start:
+                    start += RUN_BYTES
+                if e == "esa" and k in joined_end:
+                    end -= RUN_BYTES
+                copy_range(fname, start, end, out)
+    if "ssa" in exts:
+        print("r: {}".format(os.path.getsize(args.prefix + ".ssa") // RUN_BYTES))
+    if args.remove:
+        for s in shards:
+            for e in exts:
+                os.remove("{}.{}".format(s, e))
@@ -0,0 +1,20 @@
+import sys
+import struct
+import argparse
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="expands <prefix>.bwt.2bit and <prefix>.bwt.exc (pfbwt-f64 --packed-bwt) to a plain BWT on stdout")
+    parser.add_argument("prefix")
+    args = parser.parse_args()
+
+    codes = open(args.prefix + ".bwt.2bit", "rb").read()
+    exc = open(args.prefix + ".bwt.exc", "rb").read()
+    n = struct.unpack_from("<Q", codes)[0]
+    if len(codes) != 8 * (1 + (n + 31) // 32):
+        sys.stderr.write("packed BWT has the wrong size\n")
+        sys.exit(1)
+    words = struct.unpack_from("<{}Q".format((n + 31) // 32), codes, 8)
+    bwt = bytearray(b"ACGT"[(words[i // 32] >> (2 * (i % 32))) & 3] for i in range(n))
+    for row, length, c in struct.iter_unpack("<QQQ", exc):
+        bwt[row:row+length] = bytes([c]) * length
+    sys.stdout.buffer.write(bwt)
@@ -0,0 +1,18 @@
+import sys
+import argparse
+
+IBYTES = 5 # see utils.h
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="expands <prefix>.bwt.heads and <prefix>.bwt.len (pfbwt-f64 --rlbwt) to a plain BWT on stdout")
+    parser.add_argument("prefix")
+    args = parser.parse_args()
+
+    heads = open(args.prefix + ".bwt.heads", "rb").read()
+    lens = open(args.prefix + ".bwt.len", "rb").read()
+    if len(lens) != IBYTES * len(heads):
+        sys.stderr.write("heads and lengths do not match\n")
+        sys.exit(1)
+    out = sys.stdout.buffer
+    for i, c in enumerate(heads):
+        out.write(bytes([c]) * int.from_bytes(lens[i*IBYTES:(i+1)*IBYTES], "little"))
@@ -4,6 +4,7 @@
  * SACA-K algorithm.
  * The input file cannot contain the 0x0 char that is used int the BWT as 
  * the EOF symbol. The output file has extension .Bwt and length |T|+1
+ * With -s the suffix array is also written to name.sa (|T|+1 uint_t's)
  * 
  * If compiled with M64=1 uses 64 bit uints for the suffix array; 
  * the overall space is 9n bytes and the input can be as large as 2^63-1
@@ -33,12 +34,15 @@ int main(int argc, char *argv[])
   time_t start_wc = time(NULL);
 
   // check input data
-  if(argc<2){
-    printf("\nUsage:\n\t %s name\n\n", argv[0]);
+  int write_sa = argc>2 && strcmp(argv[1],"-s")==0;
+  if(argc<2+write_sa){
+    printf("\nUsage:\n\t %s [-s] name\n\n", argv[0]);
     puts("Compute the BWT of file name and output it to name.Bwt");
+    puts("With -s also output the suffix array to name.sa");
     puts("The input file cannot contain the zero character");
     exit(1);
   }
+  char *fname = argv[1+write_sa];
   puts("==== Command line:");
   for(int i=0;i<argc;i++)
     printf(" %s",argv[i]);
@@ -46,11 +50,12 @@ int main(int argc, char *argv[])
     
   // read main file
   char *name;
-  FILE *fin = fopen(argv[1],"rb");
+  FILE *fin = fopen(fname,"rb");
   if(fin==NULL) die("file open");
   // get file size
   if(fseek(fin,0,SEEK_END)!=0) die("fseek");
   n = ftell(fin);
+  if(n<0) die("ftell");
   #if !M64
   if(n > 0x7FFFFFFE) {
     printf("Text size greater than  2^31-2!\n");
@@ -63,7 +68,7 @@ int main(int argc, char *argv[])
   if(Text==NULL) die("malloc 1");
   rewind(fin);
   size_t s = fread(Text,1,n,fin);
-  if(s!=n) {
+  if(s!=(size_t) n) {
     char *msg=NULL;
     int e= asprintf(&msg,"read parse error: %zu vs %ld\n", s,n); 
     (void) e; die(msg);
@@ -77,12 +82,12 @@ int main(int argc, char *argv[])
   int depth = sacak(Text,SA, n+1);
   printf("SA computed with depth: %d\n", depth);
   // ---- output BWT
-  e = asprintf(&name,"%s.Bwt",argv[1]);
+  e = asprintf(&name,"%s.Bwt",fname);
   if(e<1) die("asprint error");  
   FILE *fbwt = fopen(name,"wb");
   free(name);
   if(fbwt==NULL) die("BWT open error");
-  assert(SA[0]==n);
+  assert(SA[0]==(uint_t) n);
   if(fputc(Text[n-1],fbwt)==EOF) die("Error writing Bwt (1)");
   for(long i=1;i<=n;i++) {
     if(SA[i]>0) 
@@ -92,6 +97,16 @@ int main(int argc, char *argv[])
     if(e==EOF) die("Error writing Bwt (2)");
   }
   if(fclose(fbwt)!=0) die("Error closing BWT");;
+  // ---- output SA
+  if(write_sa) {
+    e = asprintf(&name,"%s.sa",fname);
+    if(e<1) die("asprint error");
+    FILE *fsa = fopen(name,"wb");
+    free(name);
+    if(fsa==NULL) die("SA open error");
+    if(fwrite(SA,sizeof(uint_t),n+1,fsa)!=(size_t)n+1) die("Error writing SA");
+    if(fclose(fsa)!=0) die("Error closing SA");
+  }
   // deallocate
   free(SA);
   free(Text);
@@ -0,0 +1,39 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "phi.hpp"
+extern "C" {
+#include "gsa/gsacak.h"
+}
+
+/* checks phi and inverse phi at prefix against the full SA (<prefix>.sa, from
+ * pfbwt-f64 -s): phi(SA[k]) == SA[k-1], invphi(SA[k]) == SA[k+1], cyclically
+ */
+static int check_phi(std::string prefix) {
+    pfbwtf::PhiSamples phi(prefix + "." + EXTPHI);
+    pfbwtf::PhiSamples invphi(prefix + "." + EXTINVPHI);
+    VecFileSource<uint_t> sa(prefix + "." + EXTSA);
+    size_t n = sa.size();
+    for (size_t k = 0; k < n; ++k) {
+        if (phi(sa[k]) != sa[(k + n - 1) % n] || invphi(sa[k]) != sa[(k + 1) % n]) {
+            fprintf(stderr, "phi mismatch at SA row %lu\n", k);
+            return 1;
+        }
+    }
+    fprintf(stderr, "phi and inverse phi agree w/ the SA (%lu rows)\n", n);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    bool check = argc == 3 && !strcmp(argv[1], "-c");
+    if (argc != 2 && !check) {
+        fprintf(stderr, "usage: %s [-c] <pfbwt-f64 -r output prefix>\n", argv[0]);
+        fprintf(stderr, "builds <prefix>.phi and <prefix>.invphi from <prefix>.ssa and <prefix>.esa\n");
+        fprintf(stderr, "-c: instead check them against <prefix>.sa\n");
+        exit(1);
+    }
+    if (check) return check_phi(argv[2]);
+    size_t r = pfbwtf::build_phi<uint_t>(argv[1]);
+    fprintf(stderr, "r: %lu\n", r);
+    return 0;
+}
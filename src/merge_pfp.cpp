@@ -4,9 +4,12 @@
 #include <string>
 #include <iostream>
 #include <getopt.h>
+#include <sys/stat.h>
 #include <thread>
 #include "pfbwt_io.hpp"
 #include "pfparser.hpp"
+#include "checkpoint.hpp"
+#include "metrics.hpp"
 
 struct Args {
     std::vector<std::string> prefixes;
@@ -17,10 +20,16 @@ struct Args {
     int store_docs = 0;
     int parse_bwt = 0;
     int sai = 0;
+    int lcp = 0;
+    int ilist_records = 0;
+    int compressed_ws = 0;
+    int checkpoint = 0;
+    int resume = 0;
+    std::string metrics_fname;
 };
 
 void print_help() {
-    fprintf(stderr, "usage: ./merge_pfp [--docs] -w <window size> -p <mod> -o <output prefix> -t <threads> <prefix 1> <prefix 2> ... \n");
+    fprintf(stderr, "usage: ./merge_pfp [--docs] [-s] [--lcp] [--parse-bwt] [--ilist-records] [--compressed-workspace] [--checkpoint] [--resume] [--metrics <file.json>] -w <window size> -p <mod> -o <output prefix> -t <threads> <prefix 1> <prefix 2> ... \n");
 }
 
 Args parse_args(int argc, char** argv) {
@@ -33,7 +42,14 @@ Args parse_args(int argc, char** argv) {
         {"output", required_argument, NULL, 'o'},
         {"threads", required_argument, NULL, 't'},
         {"parse-bwt", no_argument, &args.parse_bwt, 1},
-        {"sai", no_argument, NULL, 's'}
+        {"ilist-records", no_argument, &args.ilist_records, 1},
+        {"compressed-workspace", no_argument, &args.compressed_ws, 1},
+        {"checkpoint", no_argument, &args.checkpoint, 1},
+        {"resume", no_argument, &args.resume, 1},
+        {"metrics", required_argument, NULL, 'J'},
+        {"sai", no_argument, NULL, 's'},
+        {"lcp", no_argument, &args.lcp, 1},
+        {0, 0, 0, 0}
     };
 
     while ((c = getopt_long( argc, argv, "dw:p:o:t:s", lopts, NULL) ) != -1) {
@@ -50,6 +66,8 @@ Args parse_args(int argc, char** argv) {
                 args.nthreads = atoi(optarg); break;
             case 's':
                 args.sai = 1; break;
+            case 'J':
+                args.metrics_fname = optarg; break;
             case '?':
                 std::cerr << "Unknown option.\n";
                 print_help();
@@ -112,13 +130,77 @@ pfbwtf::PfParser<> parser_merge_from_vec(pfbwtf::PfParserParams params, ParseV&
     return parser;
 }
 
+/* hashes the size and mtime of fname (nothing if it's not there) into h */
+uint64_t hash_file_stamp(const std::string& fname, uint64_t h) {
+    struct stat st;
+    if (stat(fname.data(), &st)) return h;
+    uint64_t v[3] = {static_cast<uint64_t>(st.st_size), static_cast<uint64_t>(st.st_mtim.tv_sec), static_cast<uint64_t>(st.st_mtim.tv_nsec)};
+    return pfbwtf::fnv1a(v, sizeof(v), h);
+}
+
+/* identifies the inputs and options of a merge. Inputs are identified by
+ * name and by the size and mtime of their parse files (or fasta), so a
+ * re-parsed input invalidates the checkpoint
+ */
+pfbwtf::Checkpoint merge_checkpoint_id(const Args& args) {
+    pfbwtf::Checkpoint c;
+    uint64_t h = pfbwtf::fnv1a(NULL, 0);
+    for (const auto& p: args.prefixes) {
+        h = pfbwtf::fnv1a(p.data(), p.size() + 1, h);
+        for (std::string ext: {"", ".dict", ".occ", ".parse"}) h = hash_file_stamp(p + ext, h);
+    }
+    c.set("inputs", h);
+    c.set("ninputs", args.prefixes.size());
+    c.set("w", args.w);
+    c.set("p", args.p);
+    c.set("docs", args.store_docs);
+    c.set("lcp", args.lcp);
+    return c;
+}
+
+void save_merged_parse_bwt(pfbwtf::PfParser<>& parser, const Args& args) {
+    if (!args.parse_bwt) return;
+    pfbwtf::MetricsPhase ph("bwt_of_parse");
+    pfbwtf::save_parse_bwt(parser, args.output, args.sai, args.ilist_records, args.compressed_ws);
+    if (args.lcp) pfbwtf::vec_to_file<pfbwtf::PfParser<>::UIntType>(parser.get_bwlcp(), args.output + "." + EXTBWLCP);
+}
+
+/* writes the merged parse (and its BWT, if requested) */
+void save_merged(pfbwtf::PfParser<>& parser, const Args& args, std::string ckpt_fname) {
+    pfbwtf::metrics().set("ninputs", args.prefixes.size());
+    pfbwtf::metrics().set("n", parser.get_n());
+    pfbwtf::metrics().set("parse_size", parser.get_parse_size());
+    pfbwtf::metrics().set("dict_phrases", parser.get_sorted_phrases().size());
+    {
+        pfbwtf::MetricsPhase ph("save_parse");
+        pfbwtf::save_parser(parser, args.output);
+        if (args.checkpoint) merge_checkpoint_id(args).save(ckpt_fname);
+    }
+    save_merged_parse_bwt(parser, args);
+}
+
 void merge_pfp(Args args) {
     pfbwtf::PfParserParams params;
     params.store_docs = args.store_docs;
     params.w = args.w;
     params.p = args.p;
     params.get_sai = args.sai;
+    params.get_lcp = args.lcp;
+    std::string ckpt_fname = args.output + "." + EXTMRGCKPT;
+    pfbwtf::Checkpoint ckpt;
+    if (args.resume && ckpt.load(ckpt_fname) && ckpt.matches(merge_checkpoint_id(args))) {
+        // merged parse is already on disk, only the parse BWT is left
+        fprintf(stderr, "resuming from merge checkpoint\n");
+        if (args.parse_bwt) {
+            pfbwtf::PfParser<> parser;
+            parser += pfbwtf::load_parser(args.output, params);
+            parser.finalize();
+            save_merged_parse_bwt(parser, args);
+        }
+        return;
+    }
     fprintf(stderr, "%lu %lu - %lu\n", args.nthreads, args.prefixes.size(), args.prefixes.size()/args.nthreads);
+    size_t ph = pfbwtf::metrics().begin_phase("merge");
     if (args.prefixes.size() / args.nthreads > 2) {
         // initialize threads and thread arguments
         MergeArgs margs;
@@ -151,8 +233,8 @@ void merge_pfp(Args args) {
             }
         }
         auto parser = parser_merge_from_vec(margs.params, margs.parsers);
-        pfbwtf::save_parser(parser, args.output);
-        if (args.parse_bwt) pfbwtf::save_parse_bwt(parser, args.output, args.sai);
+        pfbwtf::metrics().end_phase(ph);
+        save_merged(parser, args, ckpt_fname);
     } else {
         std::string log_fname = args.output + ".pfbwt.log";
         FILE* fp = fopen(log_fname.data(), "w");
@@ -164,13 +246,15 @@ void merge_pfp(Args args) {
             parser += pfbwtf::load_or_generate_parser_w_log(prefix, params, fp);
         }
         parser.finalize();
-        pfbwtf::save_parser(parser, args.output);
-        if (args.parse_bwt) pfbwtf::save_parse_bwt(parser, args.output, args.sai);
+        pfbwtf::metrics().end_phase(ph);
+        save_merged(parser, args, ckpt_fname);
     }
 }
 
 int main(int argc, char** argv) {
     Args args(parse_args(argc, argv));
+    if (args.metrics_fname != "") pfbwtf::metrics().open(args.metrics_fname, "merge_pfp");
     merge_pfp(args);
+    pfbwtf::metrics().write();
     return 0;
 }
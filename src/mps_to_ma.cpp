@@ -2,15 +2,27 @@
 #include <cstdio>
 #include <cstring>
 #include <cinttypes>
+#include <vector>
+#include <thread>
+#include <atomic>
 #include <getopt.h>
+#include <sys/stat.h>
 #include "marker_array.hpp"
+#include "segments.hpp"
 #include "file_wrappers.hpp"
+#include "metrics.hpp"
+extern "C" {
+#include "utils.h"
+}
 
 struct Args {
     std::string mai_fname = "";
     std::string sa_fname = "";
     std::string output = "out";
     int mmap = 0;
+    int packed_sa = 0;
+    size_t threads = 1;
+    std::string metrics_fname = "";
 };
 
 Args parse_args(int argc, char** argv) {
@@ -18,14 +30,22 @@ Args parse_args(int argc, char** argv) {
     int c;
     static struct option lopts[] = {
         {"mmap", no_argument, NULL, 'm'},
-        {"output", required_argument, NULL, 'o'}
+        {"output", required_argument, NULL, 'o'},
+        {"metrics", required_argument, NULL, 'J'},
+        {"packed-sa", no_argument, &args.packed_sa, 1},
+        {"threads", required_argument, NULL, 't'},
+        {0, 0, 0, 0}
     };
-    while ((c = getopt_long( argc, argv, "o:mh", lopts, NULL) ) != -1) {
+    while ((c = getopt_long( argc, argv, "o:t:mh", lopts, NULL) ) != -1) {
         switch(c) {
             case 'm':
                 args.mmap = 1; break;
             case 'o':
                 args.output = std::string(optarg); break;
+            case 'J':
+                args.metrics_fname = std::string(optarg); break;
+            case 't':
+                args.threads = std::max(1L, atol(optarg)); break;
             case '?':
                 fprintf(stderr,  "Unknown option.\n");
                 exit(1);
@@ -40,12 +60,69 @@ Args parse_args(int argc, char** argv) {
     return args;
 }
 
+/* for an SA split into segments (pfbwt-f64 --segment-size), writes one
+ * marker array segment per SA segment, w/ args.threads threads. A run of
+ * equal markers that spans two SA segments is split into two records.
+ */
+template <typename MPos>
+uint64_t write_segmented_marker_array(const Args& args, const std::vector<pfbwtf::Segment>& segs, size_t sa_bytes) {
+    MPos mai(args.mai_fname);
+    auto out = pfbwtf::split_ext(args.output);
+    if (out.second == "") out = {args.output, "ma"};
+    std::vector<uint64_t> nsa(segs.size()), bytes(segs.size());
+    std::atomic<size_t> next{0};
+    auto work = [&]() {
+        size_t k;
+        while ((k = next++) < segs.size()) {
+            if (segs[k].offset % sa_bytes) die("SA segment does not start at an SA entry");
+            std::string ofname = pfbwtf::segment_fname(out.first, out.second, k);
+            FILE* sa_fp = fopen(segs[k].fname.data(), "rb");
+            FILE* ofp = fopen(ofname.data(), "wb");
+            if (sa_fp == NULL) die(segs[k].fname.data());
+            if (ofp == NULL) die(ofname.data());
+            nsa[k] = write_marker_array(mai, sa_fp, ofp, sa_bytes, segs[k].offset / sa_bytes);
+            bytes[k] = ftell(ofp);
+            fclose(sa_fp);
+            if (fclose(ofp)) die(ofname.data());
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < std::min(args.threads, segs.size()); ++t) threads.emplace_back(work);
+    for (auto& t: threads) t.join();
+    pfbwtf::write_segment_index(out.first, out.second, bytes);
+    uint64_t total = 0;
+    for (auto x: nsa) total += x;
+    return total;
+}
+
 int main(int argc, char** argv) {
     Args args(parse_args(argc, argv));
-    if (args.mmap) {
-        write_marker_array<MarkerPositions<MMapFileSource>>(args.mai_fname, args.sa_fname, args.output);
+    if (args.metrics_fname != "") pfbwtf::metrics().open(args.metrics_fname, "mps_to_ma");
+    uint64_t nsa = 0;
+    size_t sa_bytes = args.packed_sa ? SABYTES : sizeof(uint64_t);
+    // a segmented SA has no <prefix>.sa, but a <prefix>.sa.segs
+    std::vector<pfbwtf::Segment> segs;
+    struct stat st;
+    if (args.sa_fname != "-" && stat(args.sa_fname.data(), &st)) {
+        auto sa = pfbwtf::split_ext(args.sa_fname);
+        segs = pfbwtf::read_segment_index(sa.first, sa.second);
+    }
+    if (segs.size()) {
+        pfbwtf::MetricsPhase ph("write_marker_array");
+        if (args.mmap) {
+            nsa = write_segmented_marker_array<MarkerPositions<MMapFileSource>>(args, segs, sa_bytes);
+        } else {
+            nsa = write_segmented_marker_array<MarkerPositions<VecFileSource>>(args, segs, sa_bytes);
+        }
     } else {
-        write_marker_array<MarkerPositions<VecFileSource>>(args.mai_fname, args.sa_fname, args.output);
+        pfbwtf::MetricsPhase ph("write_marker_array");
+        if (args.mmap) {
+            nsa = write_marker_array<MarkerPositions<MMapFileSource>>(args.mai_fname, args.sa_fname, args.output, sa_bytes);
+        } else {
+            nsa = write_marker_array<MarkerPositions<VecFileSource>>(args.mai_fname, args.sa_fname, args.output, sa_bytes);
+        }
     }
+    pfbwtf::metrics().set("sa_entries", nsa);
+    pfbwtf::metrics().write();
     return 0;
 }
@@ -4,11 +4,25 @@
 #include <string>
 #include <getopt.h>
 #include <chrono>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
 #include "pfbwt.hpp"
 #include "pfparser.hpp"
 #include "hash.hpp"
 #include "file_wrappers.hpp"
 #include "pfbwt_io.hpp"
+#include "workspace_plan.hpp"
+#include "checkpoint.hpp"
+#include "metrics.hpp"
+#include "rlbwt.hpp"
+#include "phi.hpp"
+#include "doc_array.hpp"
+#include "thresholds.hpp"
+#include "sampled_sa.hpp"
+#include "packed_bwt.hpp"
+#include "segments.hpp"
+#include "out_stream.hpp"
 extern "C" {
 #include "utils.h"
 }
@@ -29,14 +43,52 @@ struct Args {
     int pfbwt_only = 0;
     int verbose = false;
     int print_docs = 0;
+    int sparse_gsa = 0;
+    int no_glcp = 0;
+    uint64_t ext_gsa_bytes = 0;
+    size_t max_mem_mb = 0;
+    uint64_t checkpoint_rows = 0;
+    int resume = 0;
+    std::string metrics_fname;
+    int ilist_records = 0;
+    int compressed_ws = 0;
+    int mmap_populate = 0;
+    int mmap_thp = 0;
+    int rlbwt = 0;
+    int phi = 0;
+    int da = 0;
+    int rlda = 0;
+    int lcp = 0;
+    int rlcp = 0;
+    int thresholds = 0;
+    size_t sa_sample_rate = 0;
+    int packed_sa = 0;
+    int packed_bwt = 0;
+    size_t out_buf_mb = 8;
+    int sync_output = 0;
+    int direct_io = 0;
+    size_t shard = 0;
+    size_t shards = 0; // 0: not sharded
+    uint64_t segment_bytes = 0;
     size_t n = 0;
 };
 
+/* whether the BWT step needs SA values, i.e. the parse needs .bwsai */
+bool needs_sa(const Args& args) {
+    return args.sa || args.rssa || args.da || args.rlda || args.sa_sample_rate;
+}
+
+/* whether the BWT step needs LCP values, i.e. the parse needs .bwlcp */
+bool needs_lcp(const Args& args) {
+    return args.lcp || args.rlcp || args.thresholds;
+}
+
+/* also records phase in the metrics (--metrics) */
 struct Timer {
     using clock = std::chrono::system_clock;
     using sec = std::chrono::duration<double>;
 
-    Timer(std::string m) : msg(m) {
+    Timer(std::string m, std::string phase) : msg(m), ph(phase) {
         start = clock::now();
     }
 
@@ -47,6 +99,7 @@ struct Timer {
 
     std::chrono::time_point<clock> start;
     std::string msg;
+    pfbwtf::MetricsPhase ph;
 };
 
 
@@ -76,6 +129,9 @@ options\n\
     \n\
     -s                  Output full suffix array to <fasta file>.sa\n\
     \n\
+    --packed-sa         w/ -s, write SA values w/ 5 bytes each instead of 8\n\
+                        (64-bit builds only, for texts shorter than 2^40)\n\
+    \n\
     -r                  Output run-length sampled suffix arrray to \n\
                         <fasta file>.ssa (run-starts) and \n\
                         <fasta file>.esa (run-ends)\n\
@@ -86,6 +142,99 @@ options\n\
     \n\
     -m                  build BWT on external memory\n\
     \n\
+    --max-mem <int>     keep workspace arrays in RAM (randomly accessed ones\n\
+                        first) up to <int> MB, mmap the rest. Overrides -m\n\
+    \n\
+    --sparse-gsa        only sort dict suffixes longer than w (less memory\n\
+                        and time for small p)\n\
+    \n\
+    --no-glcp           do not build LCP of dict suffixes (less memory,\n\
+                        slightly more time)\n\
+    \n\
+    --ext-gsa <num>     sort dict suffixes on disk in blocks of <num> MB\n\
+                        (e.g. 0.5), then merge them (for dicts that exceed\n\
+                        RAM). Only suffixes longer than w are sorted, as w/\n\
+                        --sparse-gsa, which it replaces\n\
+    \n\
+    --ilist-records     store ilist, bwlast and bwsai interleaved in ilist\n\
+                        order (.ilrec), so they are read sequentially per\n\
+                        word. Must be given for both parsing and BWT steps\n\
+    \n\
+    --compressed-workspace  store ilist delta-coded per word (.cilist) and\n\
+                        bwlast w/ 2 bits per char (.pbwlast). Must be given\n\
+                        for both parsing and BWT steps\n\
+    \n\
+    --mmap-populate     w/ -m, read randomly accessed arrays (dict, bwlast,\n\
+                        bwsai) into memory up front\n\
+    \n\
+    --mmap-thp          w/ -m, ask for transparent huge pages\n\
+    \n\
+    --checkpoint <num>  save gSA/gLCP once sorted, and the BWT progress\n\
+                        every <num> million BWT chars (e.g. 0.1), so that a\n\
+                        run that dies can be continued w/ --resume. Both are\n\
+                        removed once the BWT is complete\n\
+    \n\
+    --resume            continue from the checkpoints under -o. Parsing is\n\
+                        skipped if the parse files are there\n\
+    \n\
+    --metrics <file>    write per-phase time, peak RSS and I/O, and algorithm\n\
+                        counters to <file> as JSON\n\
+    \n\
+    --rlbwt             output the run-length encoded BWT (run chars to\n\
+                        <fasta file>.bwt.heads, run lengths to .bwt.len)\n\
+                        instead of .bwt\n\
+    \n\
+    --packed-bwt        output the BWT w/ 2 bits per A/C/G/T to\n\
+                        <fasta file>.bwt.2bit, and runs of other chars as\n\
+                        (row, length, char) exceptions to .bwt.exc, instead\n\
+                        of .bwt\n\
+    \n\
+    --phi               w/ -r, build phi and inverse phi (r-index locate)\n\
+                        from the run-sampled SA, saved to <fasta file>.phi\n\
+                        and .invphi\n\
+    \n\
+    --da                output the document array (index of the fasta\n\
+                        record of each SA entry, as 4-byte ints) to\n\
+                        <fasta file>.da. Implies --print-docs\n\
+    \n\
+    --rlda              output the document array at run starts and run ends\n\
+                        to <fasta file>.sda and .eda, as (row, doc) pairs\n\
+                        like .ssa/.esa. Implies --print-docs\n\
+    \n\
+    --lcp               output the LCP array to <fasta file>.lcp, computed\n\
+                        in the BWT pass from the dict and the parse\n\
+    \n\
+    --rlcp              output the LCP at run starts to <fasta file>.rlcp,\n\
+                        as (row, LCP) pairs like .ssa\n\
+    \n\
+    --thresholds        output the matching statistics threshold of each run\n\
+                        (row of the min LCP since the previous run of its\n\
+                        char, 0 for the first) to <fasta file>.thr\n\
+    \n\
+    --sa-sample-rate <int>  output the SA values that are multiples of <int>\n\
+                        (.smpsa), a bit vector marking their rows\n\
+                        (.smpsa.bv) and the ISA at every <int>-th text\n\
+                        position (.smpisa), for FM-index locate\n\
+    \n\
+    --out-buffer <int>  buffer each BWT step output in two <int> MB buffers,\n\
+                        one filled while the other is written in the\n\
+                        background [default: 8]\n\
+    \n\
+    --sync-output       write output buffers from the main thread instead\n\
+    \n\
+    --direct-io         write outputs w/ O_DIRECT (bypassing the page cache)\n\
+                        where the filesystem allows it\n\
+    \n\
+    --segment-size <num>  split .bwt and .sa into segments of about <num> MB\n\
+                        (<prefix>.<k>.bwt, ...), listed in <prefix>.bwt.segs\n\
+                        and .sa.segs\n\
+    \n\
+    --shard <i>/<N>     w/ --pfbwt-only, only output the i-th (0-based) of N\n\
+                        slices of the BWT (and its SA, LCP, ...) to\n\
+                        <prefix>.shard<i>.<ext>. Run once per i, then join\n\
+                        the slices w/ scripts/merge_shards.py. Only for .bwt,\n\
+                        -s, -r, --da and --lcp\n\
+    \n\
     --parse-only        only produce parse (dict, occ, ilist, last, bwlast)\n\
                         do not build final BWT\n\
     \n\
@@ -116,6 +265,32 @@ Args parse_args(int argc, char** argv) {
         {"trim-non-acgt", no_argument, &args.trim_non_acgt, 1},
         {"non-acgt-to-a", no_argument, &args.non_acgt_to_a, 1},
         {"print-docs", no_argument, &args.print_docs, 1},
+        {"sparse-gsa", no_argument, &args.sparse_gsa, 1},
+        {"no-glcp", no_argument, &args.no_glcp, 1},
+        {"ext-gsa", required_argument, NULL, 'E'},
+        {"max-mem", required_argument, NULL, 'M'},
+        {"checkpoint", required_argument, NULL, 'K'},
+        {"resume", no_argument, &args.resume, 1},
+        {"metrics", required_argument, NULL, 'J'},
+        {"rlbwt", no_argument, &args.rlbwt, 1},
+        {"phi", no_argument, &args.phi, 1},
+        {"da", no_argument, &args.da, 1},
+        {"rlda", no_argument, &args.rlda, 1},
+        {"lcp", no_argument, &args.lcp, 1},
+        {"rlcp", no_argument, &args.rlcp, 1},
+        {"thresholds", no_argument, &args.thresholds, 1},
+        {"sa-sample-rate", required_argument, NULL, 'S'},
+        {"packed-sa", no_argument, &args.packed_sa, 1},
+        {"packed-bwt", no_argument, &args.packed_bwt, 1},
+        {"out-buffer", required_argument, NULL, 'B'},
+        {"sync-output", no_argument, &args.sync_output, 1},
+        {"direct-io", no_argument, &args.direct_io, 1},
+        {"shard", required_argument, NULL, 'D'},
+        {"segment-size", required_argument, NULL, 'G'},
+        {"ilist-records", no_argument, &args.ilist_records, 1},
+        {"compressed-workspace", no_argument, &args.compressed_ws, 1},
+        {"mmap-populate", no_argument, &args.mmap_populate, 1},
+        {"mmap-thp", no_argument, &args.mmap_thp, 1},
         {"stdout", required_argument, NULL, 'c'},
         {"verbose", no_argument, &args.verbose, 1},
         {"sa", no_argument, NULL, 's'},
@@ -146,6 +321,31 @@ Args parse_args(int argc, char** argv) {
                 args.output.assign(optarg); break;
             case 'c':
                 args.stdout_ext = optarg; break;
+            case 'E':
+                args.ext_gsa_bytes = atof(optarg) * (1 << 20);
+                if (!args.ext_gsa_bytes) die("--ext-gsa must be positive");
+                break;
+            case 'M':
+                args.max_mem_mb = atol(optarg); break;
+            case 'K':
+                args.checkpoint_rows = atof(optarg) * 1000000; break;
+            case 'J':
+                args.metrics_fname = optarg; break;
+            case 'B':
+                args.out_buf_mb = std::max(1L, atol(optarg)); break;
+            case 'S':
+                args.sa_sample_rate = atol(optarg);
+                if (!args.sa_sample_rate) die("--sa-sample-rate must be positive");
+                break;
+            case 'G':
+                args.segment_bytes = atof(optarg) * (1 << 20);
+                if (!args.segment_bytes) die("--segment-size must be positive");
+                break;
+            case 'D':
+                if (sscanf(optarg, "%zu/%zu", &args.shard, &args.shards) != 2 || args.shard >= args.shards) {
+                    die("--shard must be <i>/<N> w/ 0 <= i < N");
+                }
+                break;
             case '?':
                 fprintf(stderr, "Unknown option. Use -h for help.\n");
                 exit(1);
@@ -178,19 +378,60 @@ Args parse_args(int argc, char** argv) {
     if (args.parse_only && args.pfbwt_only) {
         die("cannot simulatneously do parse_only and pfbwt_only");
     }
+    if (args.packed_sa && sizeof(uint_t) <= SABYTES) {
+        die("--packed-sa is only for 64-bit builds");
+    }
+    if (args.phi && !args.rssa) {
+        die("--phi needs the run-sampled SA (-r)");
+    }
+    if (args.da || args.rlda) {
+        args.print_docs = 1; // doc starts are needed for the BWT step
+    }
+    if (args.rlbwt && args.stdout_ext == "bwt") {
+        die("cannot write the run-length encoded BWT to stdout");
+    }
+    if (args.packed_bwt && args.stdout_ext == "bwt") {
+        die("cannot write the packed BWT to stdout");
+    }
+    if (args.packed_bwt && args.rlbwt) {
+        die("cannot have both --packed-bwt and --rlbwt");
+    }
+    if ((args.checkpoint_rows || args.resume) && args.stdout_ext != "") {
+        die("cannot checkpoint outputs written to stdout");
+    }
+    if (args.segment_bytes) {
+        if (args.checkpoint_rows || args.resume) die("cannot checkpoint segmented outputs");
+        if (args.shards) die("cannot have both --segment-size and --shard");
+    }
+    if (args.shards) {
+        if (!args.pfbwt_only) die("--shard needs --pfbwt-only (parse once, then run each shard)");
+        if (args.rlbwt || args.packed_bwt || args.rlda || args.rlcp || args.thresholds || args.sa_sample_rate || args.phi) {
+            die("--shard only supports .bwt, -s, -r, --da and --lcp outputs");
+        }
+        if (args.stdout_ext != "") die("cannot write shards to stdout");
+        // shards would race on the gSA checkpoint
+        if (args.checkpoint_rows || args.resume) die("cannot checkpoint shards");
+    }
     return args;
 }
 
 
+/* prefix of the BWT step outputs (the parse files are always under -o) */
+std::string out_prefix(const Args& args) {
+    if (!args.shards) return args.output;
+    return args.output + ".shard" + std::to_string(args.shard);
+}
+
 pfbwtf::PfParserParams args_to_parser_params(Args args) {
     pfbwtf::PfParserParams p;
     p.w = args.w;
     p.p = args.p;
-    p.get_sai = args.sa || args.rssa;
+    p.get_sai = needs_sa(args);
     p.verbose = args.verbose;
     p.trim_non_acgt = args.trim_non_acgt;
     p.non_acgt_to_a = args.non_acgt_to_a;
     p.store_docs = args.print_docs;
+    p.get_lcp = needs_lcp(args);
     return p;
 }
 
@@ -198,10 +439,24 @@ pfbwtf::PfParserParams args_to_parser_params(Args args) {
 pfbwtf::PrefixFreeBWTParams args_to_pfbwt_params(Args args) {
     pfbwtf::PrefixFreeBWTParams p;
     p.prefix = args.output;
+    p.scratch = out_prefix(args); // concurrent shards must not share gSA files
     p.w = args.w;
-    p.sa = args.sa;
-    p.rssa  = args.rssa;
+    p.sa = args.sa || args.da || args.sa_sample_rate;
+    p.rssa  = args.rssa || args.rlda;
+    p.lcp = needs_lcp(args);
     p.verb = args.verbose;
+    if (args.sparse_gsa) p.dict_sort = pfbwtf::DictSort::SPARSE;
+    p.glcp = !args.no_glcp;
+    p.ilist_records = args.ilist_records;
+    p.compressed = args.compressed_ws;
+    p.mmap_populate = args.mmap_populate;
+    p.mmap_thp = args.mmap_thp;
+    p.checkpoint = args.checkpoint_rows > 0;
+    p.resume = args.resume;
+    if (args.ext_gsa_bytes) { // sparse as well, so it takes over --sparse-gsa
+        p.dict_sort = pfbwtf::DictSort::EXTERNAL;
+        p.ext_block = std::max<uint64_t>(1, args.ext_gsa_bytes / sizeof(uint_t));
+    }
     return p;
 }
 
@@ -214,25 +469,39 @@ size_t run_parser(Args args) {
     parse_t p(params);
     fprintf(stderr, "starting...\n");
     { // TODO: add option for more fasta files
-        Timer t("TASK\tparsing input\t");
+        Timer t("TASK\tparsing input\t", "parse");
         p.add_fasta(args.in_fname);
     }
     {
-        Timer t("TASK\tfinalizing parse, writing dict, occs, and ranks\t");
+        Timer t("TASK\tfinalizing parse, writing dict, occs, and ranks\t", "finalize_parse");
         p.finalize();
         n = p.get_n();
+        pfbwtf::metrics().set("parse_size", p.get_parse_size());
+        pfbwtf::metrics().set("dict_phrases", p.get_sorted_phrases().size());
         pfbwtf::save_parser(p, args.output);
     }
     {
-        Timer t("TASK\tranking and bwt-ing parse and processing last-chars\t");
+        Timer t("TASK\tranking and bwt-ing parse and processing last-chars\t", "bwt_of_parse");
         p.bwt_of_parse(
                 [&](const std::vector<char>& bwlast,
                     const std::vector<parse_t::UIntType>& ilist,
                     const std::vector<parse_t::UIntType>& bwsai) {
+                    if (args.ilist_records) {
+                        pfbwtf::ilist_records_to_file(bwlast, ilist, bwsai, args.output + "." + EXTILREC);
+                        return;
+                    }
+                    if (args.compressed_ws) {
+                        pfbwtf::compressed_workspace_to_file(bwlast, ilist, p.get_occs(), args.output);
+                        if (needs_sa(args)) pfbwtf::vec_to_file<parse_t::UIntType>(bwsai, args.output + "." + EXTBWSAI);
+                        return;
+                    }
                     pfbwtf::vec_to_file<char>(bwlast, args.output + "." + EXTBWLST);
                     pfbwtf::vec_to_file<parse_t::UIntType>(ilist, args.output + "." + EXTILIST);
-                    if (args.sa || args.rssa) pfbwtf::vec_to_file<parse_t::UIntType>(bwsai, args.output + "." + EXTBWSAI);
-                });
+                    if (needs_sa(args)) pfbwtf::vec_to_file<parse_t::UIntType>(bwsai, args.output + "." + EXTBWSAI);
+                }, args.ilist_records);
+    }
+    if (needs_lcp(args)) {
+        pfbwtf::vec_to_file<parse_t::UIntType>(p.get_bwlcp(), args.output + "." + EXTBWLCP);
     }
     // TODO: dump ntab to file if applicable.
     if (args.trim_non_acgt) {
@@ -244,12 +513,12 @@ size_t run_parser(Args args) {
     return n;
 }
 
-std::FILE* init_file_pointer_wb(const Args& args, std::string ext) {
-    if (args.stdout_ext == ext) {
-        return stdout;
-    } else {
-        return open_aux_file(args.output.data(), ext.data(), "wb");
-    }
+pfbwtf::OutStreamParams args_to_out_params(const Args& args) {
+    pfbwtf::OutStreamParams p;
+    p.buf_bytes = args.out_buf_mb << 20;
+    p.async = !args.sync_output;
+    p.direct = args.direct_io;
+    return p;
 }
 
 size_t read_single_int_str(const char* fname, const char* ext) {
@@ -269,13 +538,55 @@ size_t read_single_int_str(const char* fname, const char* ext) {
     return n;
 }
 
+/* opens an output file for writing, w/ O_DIRECT if the filesystem allows */
+int open_output_fd(std::string fname, int flags) {
+    int fd = open(fname.data(), flags, 0666);
+    if (fd < 0 && (flags & O_DIRECT) && errno == EINVAL) fd = open(fname.data(), flags & ~O_DIRECT, 0666);
+    if (fd < 0) die(fname.data());
+    return fd;
+}
+
+/* whether ext is written in segments (--segment-size), and the size of its entries */
+size_t segment_entry_bytes(const Args& args, std::string ext) {
+    if (!args.segment_bytes || args.stdout_ext == ext) return 0;
+    if (ext == "bwt") return 1;
+    if (ext == "sa") return args.packed_sa ? SABYTES : sizeof(uint_t);
+    return 0;
+}
+
+/* opens output <ext> (or stdout, see -c) for writing or, when resuming from
+ * ckpt, truncates it to the checkpointed offset and appends from there */
+pfbwtf::OutStream* open_output(const Args& args, std::string ext, const pfbwtf::Checkpoint* ckpt) {
+    pfbwtf::OutStreamParams p = args_to_out_params(args);
+    if (args.stdout_ext == ext) return new pfbwtf::OutStream(STDOUT_FILENO, ext, p);
+    int flags = O_WRONLY | O_CREAT | (p.direct ? O_DIRECT : 0);
+    if (ckpt == NULL) flags |= O_TRUNC;
+    if (size_t entry = segment_entry_bytes(args, ext)) {
+        // segments hold whole entries
+        p.seg_bytes = std::max<uint64_t>(1, args.segment_bytes / entry) * entry;
+        std::string base = out_prefix(args);
+        auto open_seg = [base, ext, flags](size_t k) {
+            return open_output_fd(pfbwtf::segment_fname(base, ext, k), flags);
+        };
+        return new pfbwtf::OutStream(open_seg, ext, p);
+    }
+    std::string fname = out_prefix(args) + "." + ext;
+    int fd = open_output_fd(fname, flags);
+    if (ckpt != NULL) {
+        off_t off = ckpt->get("off_" + ext);
+        if (ftruncate(fd, off) || lseek(fd, off, SEEK_SET) != off) die("could not restore output from checkpoint");
+    }
+    return new pfbwtf::OutStream(fd, ext, p);
+}
+
 template<template<typename, typename...> typename R,
-         template<typename, typename...> typename W
+         template<typename, typename...> typename W,
+         template<typename, typename...> typename D
          >
 void run_pfbwt(const Args args) {
     pfbwtf::PrefixFreeBWTParams pfbwt_args(args_to_pfbwt_params(args));
-    std::FILE* bwt_fp = init_file_pointer_wb(args, "bwt");
-    using pfbwt_t = pfbwtf::PrefixFreeBWT<R,W>;
+    if (args.max_mem_mb) pfbwtf::plan_workspace(pfbwt_args, args.max_mem_mb << 20);
+    using pfbwt_t = pfbwtf::PrefixFreeBWT<R,W,D>;
     pfbwt_t p(pfbwt_args);
     size_t r = 0;
     size_t n = args.n;
@@ -283,34 +594,210 @@ void run_pfbwt(const Args args) {
         fprintf(stderr, "reading n from file\n");
         n = read_single_int_str(args.output.data(), "n");
     }
-    if (args.sa | args.rssa ) {
-        std::FILE* sa_fp = NULL;
-        std::FILE* ssa_fp = NULL;
-        std::FILE* esa_fp = NULL;
-        if (args.sa)
-            sa_fp = init_file_pointer_wb(args, "sa");
-        if (args.rssa) {
-            ssa_fp = open_aux_file(args.output.data(), "ssa", "wb");
-            esa_fp = open_aux_file(args.output.data(), "esa", "wb");
+    // checkpoints of the BWT step are only valid for the same workspace and outputs
+    std::string ckpt_fname = args.output + "." + EXTBWTCKPT;
+    pfbwtf::Checkpoint ckpt_id(p.checkpoint_id());
+    ckpt_id.set("n", n);
+    ckpt_id.set("sa", args.sa);
+    ckpt_id.set("rlbwt", args.rlbwt);
+    ckpt_id.set("packed_bwt", args.packed_bwt);
+    ckpt_id.set("packed_sa", args.packed_sa);
+    ckpt_id.set("rssa", args.rssa);
+    ckpt_id.set("da", args.da);
+    ckpt_id.set("rlda", args.rlda);
+    ckpt_id.set("lcp", args.lcp);
+    ckpt_id.set("rlcp", args.rlcp);
+    ckpt_id.set("thresholds", args.thresholds);
+    ckpt_id.set("sa_sample_rate", args.sa_sample_rate);
+    pfbwtf::Checkpoint ckpt;
+    pfbwtf::BWTProgress start;
+    bool resuming = args.resume && ckpt.load(ckpt_fname) && ckpt.matches(ckpt_id);
+    if (resuming) {
+        start.i = ckpt.get("gsa_i");
+        start.pos = ckpt.get("pos");
+        start.pbwtc = ckpt.get("pbwtc");
+        start.prev_suf = ckpt.get("prev_suf");
+        r = ckpt.get("r");
+        fprintf(stderr, "resuming BWT from position %lu\n", start.pos);
+    } else if (args.resume) {
+        fprintf(stderr, "no usable BWT checkpoint, starting BWT from scratch\n");
+    }
+    // w/ --shard, only rows [first_row, stop.pos) are output
+    pfbwtf::BWTProgress stop;
+    uint64_t first_row = 0;
+    if (args.shards) {
+        auto slices = p.split_bwt(args.shards);
+        if (slices.back().pos != n + 1) die("BWT slices do not add up to the text length");
+        start = slices[args.shard];
+        stop = slices[args.shard + 1];
+        first_row = start.pos;
+        fprintf(stderr, "shard %lu/%lu: BWT rows [%lu, %lu)\n", args.shard, args.shards, start.pos, stop.pos);
+    }
+    // buffered and written in the background, closed at the end of the BWT step
+    std::vector<std::unique_ptr<pfbwtf::OutStream>> outputs;
+    auto add_output = [&](std::string ext) {
+        outputs.emplace_back(open_output(args, ext, resuming ? &ckpt : NULL));
+        return outputs.back().get();
+    };
+    pfbwtf::OutStream* bwt_out = NULL;
+    pfbwtf::RLBWTWriter rl;
+    pfbwtf::PackedBWTWriter pk;
+    if (args.rlbwt) {
+        pfbwtf::OutStream* heads_out = add_output(EXTRLHDS);
+        pfbwtf::OutStream* lens_out = add_output(EXTRLLEN);
+        rl = pfbwtf::RLBWTWriter(heads_out, lens_out);
+        if (resuming) {
+            rl.head = ckpt.get("rl_head");
+            rl.len = ckpt.get("rl_len");
+        }
+    } else if (args.packed_bwt) {
+        pk = pfbwtf::PackedBWTWriter(add_output(EXTPKBWT), add_output(EXTPKEXC));
+        if (resuming) {
+            pk.row = start.pos;
+            pk.word = ckpt.get("pk_word");
+            pk.exc_row = ckpt.get("pk_exc_row");
+            pk.exc_len = ckpt.get("pk_exc_len");
+            pk.exc_c = ckpt.get("pk_exc_c");
+        } else {
+            pk.write_header(n + 1);
+        }
+    } else {
+        bwt_out = add_output("bwt");
+    }
+    auto put_bwt = [&](uint8_t c) {
+        if (args.rlbwt) rl.push(c);
+        else if (args.packed_bwt) pk.push(c);
+        else bwt_out->put(c);
+    };
+    pfbwtf::OutStream* lcp_out = args.lcp ? add_output(EXTLCP) : NULL;
+    pfbwtf::OutStream* rlcp_out = args.rlcp ? add_output(EXTRLCP) : NULL;
+    pfbwtf::OutStream* thr_out = args.thresholds ? add_output(EXTTHR) : NULL;
+    pfbwtf::Thresholds thr;
+    if (args.thresholds && resuming) thr.load(ckpt);
+    typename pfbwt_t::UIntType lcp_row = start.pos;
+    auto put_lcp = [&](const pfbwtf::out_fn_arg& a) {
+        typename pfbwt_t::UIntType l = a.lcp;
+        if (args.lcp) lcp_out->put(l);
+        if (args.rlcp && a.bwtc != a.pbwtc) {
+            rlcp_out->put(lcp_row);
+            rlcp_out->put(l);
+        }
+        if (args.thresholds) {
+            typename pfbwt_t::UIntType t = thr.push(a.bwtc, l, lcp_row);
+            if (a.bwtc != a.pbwtc) thr_out->put(t);
+        }
+        ++lcp_row;
+    };
+    uint64_t ckpt_every = args.checkpoint_rows;
+    // tests simulate a crash right after the n-th BWT checkpoint
+    const char* exit_env = getenv("PFBWT_TEST_CKPT_EXIT");
+    uint64_t exit_after = exit_env ? atol(exit_env) : 0, nckpts = 0;
+    // flushes outputs, then records their offsets along w/ out_fn's state
+    auto save_ckpt = [&](const pfbwtf::BWTProgress& g, std::vector<std::pair<std::string, uint64_t>> state) {
+        pfbwtf::Checkpoint c(ckpt_id);
+        for (auto& o: outputs) {
+            o->sync();
+            c.set("off_" + o->name(), o->tell());
+        }
+        for (auto& s: state) c.set(s.first, s.second);
+        c.set("gsa_i", g.i);
+        c.set("pos", g.pos);
+        c.set("pbwtc", g.pbwtc);
+        c.set("prev_suf", g.prev_suf);
+        c.set("r", r);
+        c.set("rl_head", rl.head);
+        c.set("rl_len", rl.len);
+        c.set("pk_word", pk.word);
+        c.set("pk_exc_row", pk.exc_row);
+        c.set("pk_exc_len", pk.exc_len);
+        c.set("pk_exc_c", pk.exc_c);
+        thr.save(c);
+        c.save(ckpt_fname);
+        if (args.verbose) fprintf(stderr, "checkpoint at BWT position %lu\n", g.pos);
+        if (exit_after && ++nckpts == exit_after) {
+            fprintf(stderr, "PFBWT_TEST_CKPT_EXIT: exiting after checkpoint %lu\n", nckpts);
+            _exit(3);
+        }
+    };
+    if (needs_sa(args)) {
+        if (args.sa && args.packed_sa && n >> (8 * SABYTES)) {
+            die("text too long for --packed-sa");
+        }
+        pfbwtf::OutStream* sa_out = args.sa ? add_output("sa") : NULL;
+        pfbwtf::DocStarts docs;
+        if (args.da || args.rlda) {
+            auto doc_info = pfbwtf::load_doc_info<uint64_t>(args.output + ".docs");
+            docs = pfbwtf::DocStarts(doc_info.second, n + 1);
+            if (docs.size() > UINT32_MAX) die("too many documents for --da");
+            fprintf(stderr, "documents: %lu\n", docs.size());
+        }
+        pfbwtf::OutStream* da_out = args.da ? add_output(EXTDA) : NULL;
+        pfbwtf::OutStream* sda_out = args.rlda ? add_output(EXTSDA) : NULL;
+        pfbwtf::OutStream* eda_out = args.rlda ? add_output(EXTEDA) : NULL;
+        pfbwtf::OutStream* ssa_out = args.rssa ? add_output("ssa") : NULL;
+        pfbwtf::OutStream* esa_out = args.rssa ? add_output("esa") : NULL;
+        pfbwtf::OutStream* smpsa_out = NULL;
+        pfbwtf::BitVectorWriter smpbv;
+        MMapFileSink<typename pfbwt_t::UIntType> smpisa; // written out of order, so mmap'd
+        size_t k = args.sa_sample_rate;
+        if (k) {
+            smpsa_out = add_output(EXTSMPSA);
+            smpbv = pfbwtf::BitVectorWriter(add_output(EXTSMPBV));
+            std::string isa_fname = args.output + "." + EXTSMPISA;
+            if (resuming) {
+                smpbv.word = ckpt.get("bv_word");
+                smpbv.bits = ckpt.get("bv_bits");
+                smpisa = MMapFileSink<typename pfbwt_t::UIntType>(isa_fname);
+            } else {
+                smpbv.write_header(n + 1);
+                smpisa.init_file(isa_fname, n / k + 1);
+            }
         }
         typename pfbwt_t::UIntType psa = 0;
-        typename pfbwt_t::UIntType pi = 0, i = 0;
+        typename pfbwt_t::UIntType pi = 0, i = first_row;
+        if (resuming) {
+            psa = ckpt.get("psa");
+            pi = ckpt.get("pi");
+            i = ckpt.get("i");
+        }
         auto out_fn = [&](const pfbwtf::out_fn_arg a) {
-            fwrite(&a.bwtc, sizeof(a.bwtc), 1, bwt_fp);
+            put_bwt(a.bwtc);
+            if (needs_lcp(args)) put_lcp(a);
+            typename pfbwt_t::UIntType x = i ? a.sa : n;
             if (args.sa) {
-                typename pfbwt_t::UIntType x = i ? a.sa : n;
-                fwrite(&x, sizeof(x), 1, sa_fp);
+                if (args.packed_sa) sa_out->write(&x, SABYTES); // little-endian, as write_myint
+                else sa_out->put(x);
+            }
+            if (args.da) {
+                uint32_t d = docs(x);
+                da_out->put(d);
             }
-            if (a.bwtc != a.pbwtc) { // run_start
+            if (k) {
+                smpbv.push(x % k == 0);
+                if (x % k == 0) {
+                    smpsa_out->put(x);
+                    smpisa[x / k] = i;
+                }
+            }
+            if (a.bwtc != a.pbwtc || i == first_row) { // run_start (a shard's first row always is)
                 ++r;
+                typename pfbwt_t::UIntType y = pi ? psa : n;
                 if (args.rssa) {
-                    typename pfbwt_t::UIntType x = i ? a.sa : n;
-                    fwrite(&i, sizeof(i), 1, ssa_fp);
-                    fwrite(&x, sizeof(x), 1, ssa_fp);
-                    if (i) {
-                        typename pfbwt_t::UIntType y = pi ? psa : n;
-                        fwrite(&pi, sizeof(pi), 1, esa_fp);
-                        fwrite(&y, sizeof(y), 1, esa_fp);
+                    ssa_out->put(i);
+                    ssa_out->put(x);
+                    if (i != first_row) {
+                        esa_out->put(pi);
+                        esa_out->put(y);
+                    }
+                }
+                if (args.rlda) {
+                    typename pfbwt_t::UIntType d = docs(x);
+                    sda_out->put(i);
+                    sda_out->put(d);
+                    if (i != first_row) {
+                        d = docs(y);
+                        eda_out->put(pi);
+                        eda_out->put(d);
                     }
                 }
             }
@@ -318,50 +805,118 @@ void run_pfbwt(const Args args) {
             psa = a.sa;
             i += 1;
         };
+        auto ckpt_fn = [&](const pfbwtf::BWTProgress& g) {
+            if (k) smpisa.sync();
+            save_ckpt(g, {{"psa", psa}, {"pi", pi}, {"i", i},
+                          {"bv_word", smpbv.word}, {"bv_bits", smpbv.bits}});
+        };
         {
-            Timer t("TASK\tgenerating final BWT w/ full and/or run-length SA\t");
-            p.generate_bwt_lcp(out_fn);
+            Timer t("TASK\tgenerating final BWT w/ full and/or run-length SA\t", "generate_bwt");
+            p.generate_bwt_lcp(out_fn, ckpt_fn, start, ckpt_every, stop.i);
             // write final run
-            if (args.rssa) {
-                fwrite(&pi, sizeof(pi), 1, esa_fp);
-                fwrite(&psa, sizeof(psa), 1, esa_fp);
+            if (args.rssa && i != first_row) {
+                esa_out->put(pi);
+                esa_out->put(psa);
+            }
+            if (args.rlda && i != first_row) {
+                typename pfbwt_t::UIntType d = docs(psa);
+                eda_out->put(pi);
+                eda_out->put(d);
             }
         }
-        if (args.sa) fclose(sa_fp);
-        if (args.rssa) {
-            fclose(ssa_fp);
-            fclose(esa_fp);
-        }
+        if (k) smpbv.finish();
     } else { // default case: just output bwt
         {
+            bool shard_head = args.shards != 0; // a shard's first row starts a run
             auto out_fn = [&](const pfbwtf::out_fn_arg a) {
-                if (a.bwtc != a.pbwtc) ++r;
-                fwrite(&a.bwtc, sizeof(a.bwtc), 1, bwt_fp);
+                if (a.bwtc != a.pbwtc || shard_head) ++r;
+                shard_head = false;
+                put_bwt(a.bwtc);
+                if (needs_lcp(args)) put_lcp(a);
             };
-            Timer t("TASK\tgenerating final BWT w/o SA\t");
-            p.generate_bwt_lcp(out_fn);
+            auto ckpt_fn = [&](const pfbwtf::BWTProgress& g) { save_ckpt(g, {}); };
+            Timer t("TASK\tgenerating final BWT w/o SA\t", "generate_bwt");
+            p.generate_bwt_lcp(out_fn, ckpt_fn, start, ckpt_every, stop.i);
         }
     }
+    pfbwtf::metrics().set("n", n);
+    pfbwtf::metrics().set("r", r);
     fprintf(stderr, "n: %lu\n", n);
     fprintf(stderr, "r: %lu\n", r);
     fprintf(stderr, "n/r: %.3f\n", static_cast<double>(n) / r);
-    fclose(bwt_fp);
+    if (args.rlbwt) rl.finish();
+    if (args.packed_bwt) pk.finish();
+    {
+        Timer t("TASK\tflushing outputs\t", "flush_outputs");
+        for (auto& o: outputs) {
+            o->close();
+            if (segment_entry_bytes(args, o->name())) {
+                pfbwtf::write_segment_index(out_prefix(args), o->name(), o->segment_sizes());
+            }
+            pfbwtf::metrics().set("stalls_" + o->name(), o->stalls());
+            pfbwtf::metrics().set("stall_secs_" + o->name(), o->stall_secs());
+            if (args.verbose && o->stalls()) {
+                fprintf(stderr, "%s: waited on the disk %lu times (%.3fs)\n", o->name().data(), o->stalls(), o->stall_secs());
+            }
+        }
+        outputs.clear();
+    }
+    // BWT is complete, so its checkpoint and the gSA/gLCP it resumes from
+    // are no longer needed
+    if (args.checkpoint_rows || args.resume) {
+        remove(ckpt_fname.data());
+        p.remove_gsa_checkpoint();
+    }
+    if (args.phi) {
+        Timer t("TASK\tbuilding phi and inverse phi from run-sampled SA\t", "build_phi");
+        pfbwtf::build_phi<typename pfbwt_t::UIntType>(args.output);
+    }
+}
+
+/* identifies the input and the options that determine the parse files */
+pfbwtf::Checkpoint parse_checkpoint_id(const Args& args) {
+    pfbwtf::Checkpoint c;
+    c.set("input_name", pfbwtf::fnv1a(args.in_fname.data(), args.in_fname.size()));
+    c.set("input_size", get_file_size_(args.in_fname.data()));
+    c.set("w", args.w);
+    c.set("p", args.p);
+    c.set("sai", needs_sa(args));
+    c.set("lcp", needs_lcp(args));
+    c.set("trim_non_acgt", args.trim_non_acgt);
+    c.set("non_acgt_to_a", args.non_acgt_to_a);
+    c.set("ilist_records", args.ilist_records);
+    c.set("compressed", args.compressed_ws);
+    return c;
 }
 
 int main(int argc, char** argv) {
     Args args(parse_args(argc, argv));
+    if (args.metrics_fname != "") pfbwtf::metrics().open(args.metrics_fname, "pfbwt-f64");
     if (!args.pfbwt_only) {
-        fprintf(stderr, "running parser...\n");
-        args.n = run_parser(args); // scan file and save relevant info to disk
+        // parse checkpoints need the input to be a file
+        bool ckpt = args.in_fname != "-" && (args.checkpoint_rows || args.resume);
+        std::string ckpt_fname = args.output + "." + EXTPRSCKPT;
+        pfbwtf::Checkpoint c;
+        if (ckpt && args.resume && c.load(ckpt_fname) && c.matches(parse_checkpoint_id(args))) {
+            fprintf(stderr, "resuming from parse checkpoint\n");
+        } else {
+            fprintf(stderr, "running parser...\n");
+            args.n = run_parser(args); // scan file and save relevant info to disk
+            if (ckpt && args.checkpoint_rows) parse_checkpoint_id(args).save(ckpt_fname);
+        }
     }
     if (!args.parse_only) {
         fprintf(stderr, "generating BWT using pfbwt algorithm...\n");
-        if (args.mmap) {
+        if (args.max_mem_mb) {
+            fprintf(stderr, "workspace will be split between memory and disk (mmap)\n");
+            run_pfbwt<PlacedFileSource, PlacedFileSink, PlacedFileSinkPrivate>(args);
+        } else if (args.mmap) {
             fprintf(stderr, "workspace will be contained on disk (mmap)\n");
-            run_pfbwt<MMapFileSource, MMapFileSink>(args);
+            run_pfbwt<MMapFileSource, MMapFileSink, MMapFileSinkPrivate>(args);
         } else {
             fprintf(stderr, "workspace will be contained in memory\n");
-            run_pfbwt<VecFileSource, VecFileSinkPrivate>(args);
+            run_pfbwt<VecFileSource, VecFileSinkPrivate, VecFileSinkPrivate>(args);
         }
     }
+    pfbwtf::metrics().write();
 }
@@ -0,0 +1,294 @@
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cinttypes>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "rlbwt.hpp"
+#include "segments.hpp"
+#include "phi.hpp"
+#include "file_wrappers.hpp"
+#include "metrics.hpp"
+extern "C" {
+#include "utils.h"
+#include "gsa/gsacak.h"
+#ifndef AC_KSEQ_H
+#include "kseq.h"
+KSEQ_INIT(gzFile, gzread);
+#endif
+}
+
+/* count and locate queries by backward search over the BWT that pfbwt-f64
+ * writes (RLBWT, or a packed or plain .bwt which is run-length encoded on load).
+ * occurrences are located w/ the full SA (.sa, from -s) if there is one, and
+ * otherwise w/ the run-sampled SA (.ssa/.esa, from -r) and phi, r-index style
+ */
+
+struct Args {
+    std::string prefix = "";
+    std::string queries = "";
+    std::string output = "";
+    int locate = 0;
+    size_t max_locate = 0;
+    size_t nthreads = 1;
+    size_t batch = 100000;
+    int run_sampled = 0;
+    std::string metrics_fname = "";
+};
+
+void print_help() {
+    fprintf(stderr, "usage: ./pfbwt-query [options] <pfbwt-f64 output prefix> <queries.fa|fq[.gz]>\n\
+    \n\
+    -l, --locate            report the text positions of each query's occurrences\n\
+    -m, --max-locate <int>  report at most <int> positions per query (default: all)\n\
+    -t, --threads <int>     query threads (default: 1)\n\
+    -b, --batch <int>       queries read and answered at once (default: 100000)\n\
+    -r, --run-sampled       locate w/ the run-sampled SA and phi even if <prefix>.sa exists.\n\
+                            <prefix>.phi is built if missing\n\
+    -o, --output <file>     write results here instead of stdout\n\
+    --metrics <file>        write load/query times and counters as JSON\n\
+    \n\
+    output is one line per query: name, length, count and w/ -l the sorted,\n\
+    comma separated positions\n");
+}
+
+Args parse_args(int argc, char** argv) {
+    Args args;
+    int c;
+    static struct option lopts[] = {
+        {"locate", no_argument, NULL, 'l'},
+        {"max-locate", required_argument, NULL, 'm'},
+        {"threads", required_argument, NULL, 't'},
+        {"batch", required_argument, NULL, 'b'},
+        {"run-sampled", no_argument, NULL, 'r'},
+        {"output", required_argument, NULL, 'o'},
+        {"metrics", required_argument, NULL, 'J'},
+        {"help", no_argument, NULL, 'h'},
+        {0, 0, 0, 0}
+    };
+    while ((c = getopt_long( argc, argv, "lm:t:b:ro:h", lopts, NULL) ) != -1) {
+        switch(c) {
+            case 'l':
+                args.locate = 1; break;
+            case 'm':
+                args.max_locate = std::stoull(optarg); break;
+            case 't':
+                args.nthreads = std::max(1, atoi(optarg)); break;
+            case 'b':
+                args.batch = std::max(1, atoi(optarg)); break;
+            case 'r':
+                args.run_sampled = 1; break;
+            case 'o':
+                args.output = optarg; break;
+            case 'J':
+                args.metrics_fname = optarg; break;
+            case 'h':
+                print_help(); exit(0);
+            case '?':
+                fprintf(stderr, "Unknown option.\n");
+                print_help();
+                exit(1);
+            case ':':
+                fprintf(stderr, "no argument specified for option\n");
+                print_help();
+                exit(1);
+        }
+    }
+    if (argc - optind != 2) {
+        print_help();
+        exit(1);
+    }
+    args.prefix = argv[optind++];
+    args.queries = argv[optind++];
+    return args;
+}
+
+static bool file_exists(std::string fname) {
+    struct stat st;
+    return !stat(fname.data(), &st);
+}
+
+class Index {
+
+    public:
+
+    Index(const Args& args) : bwt_(args.prefix) {
+        if (!args.locate) return;
+        std::string sa_fname = args.prefix + "." + EXTSA;
+        auto segs = pfbwtf::read_segment_index(args.prefix, EXTSA); // --segment-size
+        if (!args.run_sampled && (segs.size() || file_exists(sa_fname))) {
+            if (segs.empty()) segs.push_back(pfbwtf::Segment{sa_fname, 0, get_file_size_(sa_fname.data())});
+            uint64_t size = 0;
+            for (auto& sg: segs) {
+                sa_segs_.emplace_back(sg.fname);
+                if (sa_segs_.back().size() != sg.bytes) die("SA segment has the wrong size");
+                size += sg.bytes;
+            }
+            seg_bytes_ = std::max<uint64_t>(1, segs[0].bytes); // all but the last are the same
+            if (size == bwt_.size() * SABYTES) sa_bytes_ = SABYTES; // --packed-sa
+            else if (size != bwt_.size() * sizeof(uint_t)) die("SA and BWT lengths differ");
+            fprintf(stderr, "locating w/ %s\n", sa_fname.data());
+            return;
+        }
+        run_sampled_ = true;
+        if (!file_exists(args.prefix + "." + EXTPHI)) {
+            fprintf(stderr, "building %s.%s\n", args.prefix.data(), EXTPHI);
+            pfbwtf::build_phi<uint_t>(args.prefix);
+        }
+        phi_ = pfbwtf::PhiSamples(args.prefix + "." + EXTPHI);
+        // SA at the end of each run, for the toehold
+        VecFileSource<uint_t> esa(args.prefix + "." + EXTESA);
+        if (esa.size() != 2 * bwt_.runs()) die("run-sampled SA does not match the BWT runs");
+        run_end_sa_.resize(bwt_.runs());
+        for (size_t k = 0; k < bwt_.runs(); ++k) {
+            if (bwt_.run_of(esa[2*k]) != k || (k + 1 < bwt_.runs() && bwt_.run_of(esa[2*k] + 1) != k + 1)) {
+                die("run-sampled SA does not match the BWT runs");
+            }
+            run_end_sa_[k] = esa[2*k+1];
+        }
+        fprintf(stderr, "locating w/ %s.%s and the run-sampled SA\n", args.prefix.data(), EXTPHI);
+    }
+
+    /* backward search for p. returns the number of occurrences, and if locs
+     * is given, fills it w/ up to max positions (0 for all), sorted */
+    uint64_t query(const std::string& p, std::vector<uint64_t>* locs, size_t max) const {
+        uint64_t sp = 0, ep = bwt_.size();
+        uint64_t toehold = run_sampled_ ? run_end_sa_.back() : 0; // SA[ep-1]
+        for (size_t i = p.size(); i-- > 0; ) {
+            uint8_t c = p[i];
+            uint64_t nsp = bwt_.LF(c, sp), nep = bwt_.LF(c, ep);
+            if (nsp >= nep) return 0;
+            if (run_sampled_) {
+                // the last c in [sp, ep) becomes row nep-1
+                size_t k = bwt_.run_of(ep - 1);
+                if (bwt_.head(k) != c) toehold = run_end_sa_[bwt_.pred_run(c, k)];
+                --toehold;
+            }
+            sp = nsp;
+            ep = nep;
+        }
+        if (locs) {
+            uint64_t m = max ? std::min<uint64_t>(max, ep - sp) : ep - sp;
+            locs->clear();
+            if (run_sampled_) {
+                uint64_t x = toehold;
+                for (uint64_t j = 0; j < m; ++j) {
+                    locs->push_back(x);
+                    x = phi_(x);
+                }
+            } else {
+                for (uint64_t j = sp; j < sp + m; ++j) locs->push_back(sa_at(j));
+            }
+            std::sort(locs->begin(), locs->end());
+        }
+        return ep - sp;
+    }
+
+    const pfbwtf::RLBWT& bwt() const { return bwt_; }
+
+    private:
+
+    // little-endian, so a packed value is the low sa_bytes_ bytes.
+    // segments hold whole values
+    uint64_t sa_at(uint64_t j) const {
+        uint64_t x = 0;
+        uint64_t off = j * sa_bytes_;
+        memcpy(&x, sa_segs_[off / seg_bytes_].data() + off % seg_bytes_, sa_bytes_);
+        return x;
+    }
+
+    pfbwtf::RLBWT bwt_;
+    bool run_sampled_ = false;
+    std::vector<MMapFileSource<uint8_t>> sa_segs_;
+    uint64_t seg_bytes_ = 1;
+    size_t sa_bytes_ = sizeof(uint_t);
+    pfbwtf::PhiSamples phi_;
+    std::vector<uint64_t> run_end_sa_;
+};
+
+struct Query {
+    std::string name;
+    std::string seq;
+};
+
+/* answers queries [start, end) of a batch, one output line each */
+void query_worker(const Index& idx, const Args& args, const std::vector<Query>& batch,
+                  std::vector<std::string>& out, size_t start, size_t end, uint64_t& nfound) {
+    std::vector<uint64_t> locs;
+    for (size_t i = start; i < end; ++i) {
+        uint64_t cnt = idx.query(batch[i].seq, args.locate ? &locs : NULL, args.max_locate);
+        nfound += cnt > 0;
+        std::string& line = out[i];
+        line = batch[i].name + "\t" + std::to_string(batch[i].seq.size()) + "\t" + std::to_string(cnt);
+        if (args.locate) {
+            line += "\t";
+            for (size_t j = 0; j < (cnt ? locs.size() : 0); ++j) {
+                if (j) line += ",";
+                line += std::to_string(locs[j]);
+            }
+        }
+        line += "\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    Args args(parse_args(argc, argv));
+    if (args.metrics_fname != "") pfbwtf::metrics().open(args.metrics_fname, "pfbwt-query");
+    FILE* out = stdout;
+    if (args.output != "" && (out = fopen(args.output.data(), "w")) == NULL) die("could not open output");
+
+    Index* idx;
+    {
+        pfbwtf::MetricsPhase ph("load");
+        idx = new Index(args);
+    }
+    fprintf(stderr, "n: %lu\nr: %lu\n", idx->bwt().size(), idx->bwt().runs());
+
+    gzFile fp = args.queries == "-" ? gzdopen(fileno(stdin), "r") : gzopen(args.queries.data(), "r");
+    if (fp == NULL) die("failed to open queries!\n");
+    kseq_t* seq = kseq_init(fp);
+    uint64_t nqueries = 0, nfound = 0;
+    std::vector<Query> batch;
+    std::vector<std::string> lines;
+    std::vector<uint64_t> found(args.nthreads);
+    bool more = true;
+    {
+        pfbwtf::MetricsPhase ph("query");
+        while (more) {
+            batch.clear();
+            while (batch.size() < args.batch && (more = kseq_read(seq) >= 0)) {
+                batch.push_back({seq->name.s, seq->seq.s});
+                for (auto& c: batch.back().seq) c = toupper(c); // as the text is
+            }
+            if (!batch.size()) break;
+            lines.resize(batch.size());
+            size_t per = (batch.size() + args.nthreads - 1) / args.nthreads;
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < args.nthreads; ++t) {
+                size_t s = std::min(batch.size(), t * per), e = std::min(batch.size(), s + per);
+                threads.emplace_back(query_worker, std::cref(*idx), std::cref(args), std::cref(batch),
+                                     std::ref(lines), s, e, std::ref(found[t]));
+            }
+            for (auto& t: threads) t.join();
+            for (size_t i = 0; i < batch.size(); ++i) {
+                if (fwrite(lines[i].data(), 1, lines[i].size(), out) != lines[i].size()) die("could not write results");
+            }
+            nqueries += batch.size();
+        }
+    }
+    for (auto f: found) nfound += f;
+    fprintf(stderr, "queries: %lu\nfound: %lu\n", nqueries, nfound);
+    pfbwtf::metrics().set("queries", nqueries);
+    pfbwtf::metrics().set("queries_found", nfound);
+    pfbwtf::metrics().write();
+
+    kseq_destroy(seq);
+    gzclose(fp);
+    if (out != stdout) fclose(out);
+    delete idx;
+    return 0;
+}
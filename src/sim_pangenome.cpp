@@ -0,0 +1,469 @@
+/* Author: Taher Mun
+ * simulates a pangenome for scale testing: a random reference (w/ runs of Ns)
+ * plus haplotypes that share variants according to a random coalescent tree,
+ * written as FASTA (reference first, then each haplotype, as vcf_to_bwt.py
+ * orders them) and as a bgzipped VCF of the variants. Optionally writes the
+ * true BWT and SA of the FASTA, as pfbwt-f64 -s would, for small inputs.
+ *
+ * Only the reference and the variants are kept in memory, so inputs much
+ * larger than RAM (many haplotypes) can be generated.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <getopt.h>
+extern "C" {
+#include <htslib/bgzf.h>
+#include <htslib/vcf.h>
+#include "utils.h"
+#include "gsa/gsacak.h"
+}
+
+struct Args {
+    std::string output = "sim";
+    size_t nchroms = 1;
+    size_t chrom_len = 1000000;
+    size_t haplotypes = 8;
+    double snp_rate = 0.001;
+    double indel_rate = 0.0001;
+    size_t max_indel = 10;
+    double n_frac = 0;
+    size_t n_run_len = 1000;
+    uint64_t seed = 42;
+    int truth = 0;
+    size_t w = 10;
+};
+
+/* random coalescent (Kingman) tree over the haplotypes. Leaves are numbered
+ * in DFS order, so the haplotypes below each node form a range [lo, hi).
+ * Variants are dropped on branches w/ probability proportional to their
+ * length, which gives the haplotypes a shared-ancestry structure.
+ */
+class AncestryTree {
+
+    public:
+
+    struct Branch {
+        size_t lo, hi; // haplotypes below the branch
+        double len;
+    };
+
+    AncestryTree(size_t nhaps, std::mt19937_64& rng) {
+        if (nhaps == 1) {
+            branches_.push_back({0, 1, 1.0});
+        } else {
+            build(nhaps, rng);
+        }
+        double s = 0;
+        for (auto& b: branches_) {
+            s += b.len;
+            cum_.push_back(s);
+        }
+    }
+
+    const Branch& sample(std::mt19937_64& rng) const {
+        double x = std::uniform_real_distribution<double>(0, cum_.back())(rng);
+        size_t i = std::upper_bound(cum_.begin(), cum_.end(), x) - cum_.begin();
+        return branches_[std::min(i, branches_.size() - 1)];
+    }
+
+    private:
+
+    struct Node {
+        double t = 0;
+        size_t left = 0, right = 0; // children (leaves have none)
+        size_t lo = 0, hi = 0;
+    };
+
+    void build(size_t nhaps, std::mt19937_64& rng) {
+        std::vector<Node> nodes(nhaps);
+        std::vector<size_t> lineages(nhaps);
+        for (size_t i = 0; i < nhaps; ++i) lineages[i] = i;
+        double t = 0;
+        while (lineages.size() > 1) {
+            double k = lineages.size();
+            t += std::exponential_distribution<double>(k * (k - 1) / 2)(rng);
+            std::swap(lineages[rng() % lineages.size()], lineages.back());
+            size_t a = lineages.back();
+            lineages.pop_back();
+            std::swap(lineages[rng() % lineages.size()], lineages.back());
+            size_t b = lineages.back();
+            lineages.pop_back();
+            Node n;
+            n.t = t;
+            n.left = a;
+            n.right = b;
+            nodes.push_back(n);
+            lineages.push_back(nodes.size() - 1);
+        }
+        // number the leaves in DFS order (iteratively, the tree can be deep)
+        size_t root = nodes.size() - 1, nleaves = 0;
+        std::vector<std::pair<size_t, bool>> stack = {{root, false}};
+        while (stack.size()) {
+            auto [v, done] = stack.back();
+            stack.pop_back();
+            if (v < nhaps) {
+                nodes[v].lo = nleaves++;
+                nodes[v].hi = nleaves;
+            } else if (done) {
+                nodes[v].lo = nodes[nodes[v].left].lo;
+                nodes[v].hi = nodes[nodes[v].right].hi;
+            } else {
+                stack.push_back({v, true});
+                stack.push_back({nodes[v].right, false});
+                stack.push_back({nodes[v].left, false});
+            }
+        }
+        for (size_t v = nhaps; v < nodes.size(); ++v) {
+            for (size_t c: {nodes[v].left, nodes[v].right}) {
+                branches_.push_back({nodes[c].lo, nodes[c].hi, nodes[v].t - nodes[c].t});
+            }
+        }
+    }
+
+    std::vector<Branch> branches_;
+    std::vector<double> cum_;
+};
+
+struct Variant {
+    size_t pos; // 0-based
+    size_t ref_len;
+    std::string alt;
+    size_t lo, hi; // haplotypes carrying alt
+};
+
+struct Chrom {
+    std::string name;
+    std::string seq;
+    std::vector<Variant> vars;
+};
+
+void print_help() {
+    fprintf(stderr,
+"sim_pangenome. simulates a reference and haplotypes w/ shared variants\n\
+\n\
+usage\n\
+    ./sim_pangenome [options]\n\
+\n\
+results\n\
+    <out>.ref.fa        reference\n\
+    <out>.fa            reference, then each haplotype (<sample>.<0|1>.<chrom>)\n\
+    <out>.vcf.gz        variants, w/ phased diploid genotypes (and .csi index)\n\
+    <out>.truth.bwt     w/ --truth, BWT of <out>.fa as built by pfbwt-f64\n\
+    <out>.truth.sa      w/ --truth, SA of <out>.fa as built by pfbwt-f64 -s\n\
+\n\
+options\n\
+    -o <prefix>         output prefix [default: sim]\n\
+    \n\
+    -c <int>            number of chromosomes [default: 1]\n\
+    \n\
+    -l <int>            length of each chromosome [default: 1000000]\n\
+    \n\
+    -H <int>            number of haplotypes [default: 8]\n\
+    \n\
+    -d <float>          SNP rate per reference base [default: 0.001]\n\
+    \n\
+    -i <float>          indel rate per reference base [default: 0.0001]\n\
+    \n\
+    --max-indel <int>   maximum indel length [default: 10]\n\
+    \n\
+    --n-frac <float>    fraction of the reference in runs of Ns [default: 0]\n\
+    \n\
+    --n-run-len <int>   mean length of runs of Ns [default: 1000]\n\
+    \n\
+    --seed <int>        random seed [default: 42]\n\
+    \n\
+    --truth             also write the true BWT and SA (needs ~9 bytes per\n\
+                        output char of memory, so small inputs only)\n\
+    \n\
+    -w <int>            window size pfbwt-f64 will be run with (it adds w As\n\
+                        after each sequence), for --truth [default: 10]\n\
+    \n\
+    -h                  print this help message\n\
+");
+}
+
+Args parse_args(int argc, char** argv) {
+    Args args;
+    int c;
+    static struct option lopts[] = {
+        {"max-indel", required_argument, NULL, 'X'},
+        {"n-frac", required_argument, NULL, 'F'},
+        {"n-run-len", required_argument, NULL, 'R'},
+        {"seed", required_argument, NULL, 'S'},
+        {"truth", no_argument, &args.truth, 1},
+        {"output", required_argument, NULL, 'o'},
+        {0, 0, 0, 0}
+    };
+    while ((c = getopt_long( argc, argv, "o:c:l:H:d:i:w:h", lopts, NULL) ) != -1) {
+        switch(c) {
+            case 'o':
+                args.output = optarg; break;
+            case 'c':
+                args.nchroms = atol(optarg); break;
+            case 'l':
+                args.chrom_len = atol(optarg); break;
+            case 'H':
+                args.haplotypes = atol(optarg); break;
+            case 'd':
+                args.snp_rate = atof(optarg); break;
+            case 'i':
+                args.indel_rate = atof(optarg); break;
+            case 'w':
+                args.w = atol(optarg); break;
+            case 'X':
+                args.max_indel = atol(optarg); break;
+            case 'F':
+                args.n_frac = atof(optarg); break;
+            case 'R':
+                args.n_run_len = atol(optarg); break;
+            case 'S':
+                args.seed = strtoull(optarg, NULL, 10); break;
+            case 'h':
+                print_help(); exit(0);
+            case '?':
+                fprintf(stderr, "Unknown option. Use -h for help.\n");
+                exit(1);
+        }
+    }
+    if (!args.nchroms || !args.chrom_len || !args.haplotypes) die("-c, -l and -H must be > 0");
+    if (args.snp_rate < 0 || args.indel_rate < 0 || args.snp_rate + args.indel_rate > 1) die("invalid variant rates");
+    if (args.n_frac < 0 || args.n_frac >= 1) die("--n-frac must be in [0, 1)");
+    if (!args.max_indel || !args.n_run_len) die("--max-indel and --n-run-len must be > 0");
+    return args;
+}
+
+char random_base(std::mt19937_64& rng) {
+    return "ACGT"[rng() & 3];
+}
+
+/* random ACGT sequence w/ n_frac of it in runs of Ns of mean length n_run_len */
+std::string random_reference(const Args& args, std::mt19937_64& rng) {
+    std::string s(args.chrom_len, 'A');
+    for (auto& c: s) c = random_base(rng);
+    if (args.n_frac > 0) {
+        // mean gap between runs chosen so that runs cover n_frac of s
+        double m = args.n_run_len;
+        std::geometric_distribution<size_t> gap(std::min(1.0, args.n_frac / (m * (1 - args.n_frac))));
+        std::geometric_distribution<size_t> run(1 / m);
+        for (size_t i = gap(rng); i < s.size(); i += gap(rng)) {
+            size_t e = std::min(s.size(), i + 1 + run(rng));
+            std::fill(s.begin() + i, s.begin() + e, 'N');
+            i = e;
+        }
+    }
+    return s;
+}
+
+/* non-overlapping SNPs and indels on ACGT stretches of c.seq */
+void random_variants(const Args& args, const AncestryTree& tree, Chrom& c, std::mt19937_64& rng) {
+    double rate = args.snp_rate + args.indel_rate;
+    if (rate <= 0) return;
+    std::geometric_distribution<size_t> skip(rate);
+    std::uniform_real_distribution<double> u(0, 1);
+    const std::string& s = c.seq;
+    for (size_t pos = skip(rng); pos < s.size(); pos += skip(rng)) {
+        Variant v;
+        v.pos = pos;
+        v.ref_len = 1;
+        if (u(rng) * rate < args.snp_rate) {
+            v.alt = std::string(1, "ACGT"[(seq_nt4_table[static_cast<uint8_t>(s[pos])] + 1 + rng() % 3) & 3]);
+        } else {
+            size_t l = 1 + rng() % args.max_indel;
+            v.alt = std::string(1, s[pos]);
+            if (rng() & 1) { // insertion after pos
+                for (size_t i = 0; i < l; ++i) v.alt.push_back(random_base(rng));
+            } else { // deletion of the l bases after pos
+                v.ref_len = l + 1;
+            }
+        }
+        if (pos + v.ref_len > s.size() || std::find(s.begin() + pos, s.begin() + pos + v.ref_len, 'N') != s.begin() + pos + v.ref_len) {
+            ++pos;
+            continue;
+        }
+        auto& b = tree.sample(rng);
+        v.lo = b.lo;
+        v.hi = b.hi;
+        c.vars.push_back(v);
+        pos += v.ref_len;
+    }
+}
+
+/* calls out(ptr, len) on the pieces of haplotype h of c, in order */
+template<typename Fn>
+void emit_haplotype(const Chrom& c, size_t h, Fn out) {
+    size_t p = 0;
+    for (const auto& v: c.vars) {
+        if (h < v.lo || h >= v.hi) continue;
+        out(c.seq.data() + p, v.pos - p);
+        out(v.alt.data(), v.alt.size());
+        p = v.pos + v.ref_len;
+    }
+    out(c.seq.data() + p, c.seq.size() - p);
+}
+
+std::string sample_name(size_t h) {
+    return "sample" + std::to_string(h / 2) + "." + std::to_string(h % 2);
+}
+
+/* FASTA w/ 60 columns per line */
+class FastaWriter {
+
+    public:
+
+    FastaWriter(std::string fname) {
+        fp_ = fopen(fname.data(), "w");
+        if (fp_ == NULL) die("could not open FASTA output");
+    }
+
+    ~FastaWriter() {
+        end_record();
+        fclose(fp_);
+    }
+
+    void start_record(std::string name) {
+        end_record();
+        fprintf(fp_, ">%s\n", name.data());
+    }
+
+    void write(const char* s, size_t n) {
+        while (n) {
+            size_t x = std::min(n, 60 - col_);
+            fwrite(s, 1, x, fp_);
+            s += x;
+            n -= x;
+            col_ += x;
+            if (col_ == 60) {
+                fputc('\n', fp_);
+                col_ = 0;
+            }
+        }
+    }
+
+    private:
+
+    void end_record() {
+        if (col_) fputc('\n', fp_);
+        col_ = 0;
+    }
+
+    std::FILE* fp_;
+    size_t col_ = 0;
+};
+
+void write_fasta(const Args& args, const std::vector<Chrom>& chroms) {
+    {
+        FastaWriter ref(args.output + ".ref.fa");
+        for (const auto& c: chroms) {
+            ref.start_record(c.name);
+            ref.write(c.seq.data(), c.seq.size());
+        }
+    }
+    FastaWriter fa(args.output + ".fa");
+    for (const auto& c: chroms) {
+        fa.start_record(c.name);
+        fa.write(c.seq.data(), c.seq.size());
+    }
+    for (size_t h = 0; h < args.haplotypes; ++h) {
+        for (const auto& c: chroms) {
+            fa.start_record(sample_name(h) + "." + c.name);
+            emit_haplotype(c, h, [&](const char* s, size_t n) { fa.write(s, n); });
+        }
+    }
+}
+
+void write_vcf(const Args& args, const std::vector<Chrom>& chroms) {
+    std::string fname = args.output + ".vcf.gz";
+    BGZF* fp = bgzf_open(fname.data(), "w");
+    if (fp == NULL) die("could not open VCF output");
+    std::string buf;
+    auto flush = [&]() {
+        if (bgzf_write(fp, buf.data(), buf.size()) < 0) die("could not write VCF");
+        buf.clear();
+    };
+    buf += "##fileformat=VCFv4.3\n##source=sim_pangenome\n";
+    buf += "##reference=" + args.output + ".ref.fa\n";
+    for (const auto& c: chroms) {
+        buf += "##contig=<ID=" + c.name + ",length=" + std::to_string(c.seq.size()) + ">\n";
+    }
+    buf += "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Genotype\">\n";
+    buf += "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT";
+    for (size_t h = 0; h < args.haplotypes; h += 2) buf += "\tsample" + std::to_string(h / 2);
+    buf += "\n";
+    size_t id = 0;
+    for (const auto& c: chroms) {
+        for (const auto& v: c.vars) {
+            buf += c.name + "\t" + std::to_string(v.pos + 1) + "\tvar" + std::to_string(id++) + "\t";
+            buf.append(c.seq, v.pos, v.ref_len);
+            buf += "\t" + v.alt + "\t.\t.\t.\tGT";
+            for (size_t h = 0; h < args.haplotypes; h += 2) {
+                buf += h >= v.lo && h < v.hi ? "\t1" : "\t0";
+                // last sample is haploid if there is an odd number of haplotypes
+                if (h + 1 < args.haplotypes) buf += h + 1 >= v.lo && h + 1 < v.hi ? "|1" : "|0";
+            }
+            buf += "\n";
+            if (buf.size() > (1 << 20)) flush();
+        }
+    }
+    flush();
+    if (bgzf_close(fp) < 0) die("could not write VCF");
+    if (bcf_index_build(fname.data(), 14) < 0) fprintf(stderr, "warning: could not index %s\n", fname.data());
+}
+
+/* BWT and SA of the text pfbwt-f64 builds from <out>.fa: each sequence
+ * followed by w As, then the 0x00 terminator
+ */
+void write_truth(const Args& args, const std::vector<Chrom>& chroms) {
+    std::vector<uint8_t> t;
+    auto out = [&](const char* s, size_t n) { t.insert(t.end(), s, s + n); };
+    for (const auto& c: chroms) {
+        out(c.seq.data(), c.seq.size());
+        t.insert(t.end(), args.w, 'A');
+    }
+    for (size_t h = 0; h < args.haplotypes; ++h) {
+        for (const auto& c: chroms) {
+            emit_haplotype(c, h, out);
+            t.insert(t.end(), args.w, 'A');
+        }
+    }
+    t.push_back(0);
+    std::vector<uint_t> sa(t.size());
+    if (sacak(t.data(), sa.data(), t.size()) < 0) die("error computing truth SA");
+    std::FILE* sa_fp = fopen((args.output + ".truth.sa").data(), "wb");
+    std::FILE* bwt_fp = fopen((args.output + ".truth.bwt").data(), "wb");
+    if (sa_fp == NULL || bwt_fp == NULL) die("could not open truth outputs");
+    std::vector<uint8_t> bwt(sa.size());
+    for (size_t i = 0; i < sa.size(); ++i) bwt[i] = sa[i] ? t[sa[i] - 1] : 0;
+    if (fwrite(sa.data(), sizeof(uint_t), sa.size(), sa_fp) != sa.size() ||
+        fwrite(bwt.data(), 1, bwt.size(), bwt_fp) != bwt.size()) die("could not write truth outputs");
+    fclose(sa_fp);
+    fclose(bwt_fp);
+}
+
+int main(int argc, char** argv) {
+    Args args(parse_args(argc, argv));
+    std::mt19937_64 rng(args.seed);
+    std::vector<Chrom> chroms(args.nchroms);
+    size_t nvars = 0, total = 0;
+    for (size_t i = 0; i < args.nchroms; ++i) {
+        Chrom& c = chroms[i];
+        c.name = "chr" + std::to_string(i + 1);
+        c.seq = random_reference(args, rng);
+        AncestryTree tree(args.haplotypes, rng); // independent per chromosome
+        random_variants(args, tree, c, rng);
+        nvars += c.vars.size();
+        for (size_t h = 0; h < args.haplotypes; ++h) {
+            emit_haplotype(c, h, [&](const char*, size_t n) { total += n; });
+        }
+        total += c.seq.size();
+    }
+    fprintf(stderr, "%lu variants, %lu output chars\n", nvars, total);
+    write_fasta(args, chroms);
+    write_vcf(args, chroms);
+    if (args.truth) write_truth(args, chroms);
+    return 0;
+}
@@ -0,0 +1,57 @@
+#!/bin/env python3
+""" checks <prefix>.lcp (and <prefix>.rlcp, <prefix>.thr if present) against the LCP of
+consecutive suffixes in <prefix>.sa, over the text pfbwt-f64 builds from the
+fasta (records uppercased, each followed by w As, then the terminator) """
+import sys
+import os
+import struct
+
+
+def ints(fname):
+    b = open(fname, "rb").read()
+    return struct.unpack("<{}Q".format(len(b) // 8), b)
+
+
+def main():
+    if len(sys.argv) != 4:
+        sys.stderr.write("usage: check_lcp.py <fasta> <prefix> <w>\n")
+        sys.exit(1)
+    fasta, prefix, w = sys.argv[1], sys.argv[2], int(sys.argv[3])
+    seqs = []
+    for line in open(fasta):
+        if line[0] == '>':
+            seqs.append([])
+        else:
+            seqs[-1].append(line.strip().upper())
+    t = ("".join("".join(s) + "A" * w for s in seqs) + "\0").encode()
+    sa = ints(prefix + ".sa")
+    lcp = ints(prefix + ".lcp")
+    if len(sa) != len(t) or len(lcp) != len(t):
+        sys.exit("lengths differ: text {}, sa {}, lcp {}".format(len(t), len(sa), len(lcp)))
+    for i in range(1, len(sa)):
+        a, b = sa[i-1], sa[i]
+        l = 0
+        while t[a+l] == t[b+l]: # the terminator is unique
+            l += 1
+        if l != lcp[i]:
+            sys.exit("LCP mismatch at row {}: {} vs {}".format(i, lcp[i], l))
+    if os.path.exists(prefix + ".rlcp"):
+        bwt = open(prefix + ".bwt", "rb").read()
+        rows = [i for i in range(len(bwt)) if not i or bwt[i] != bwt[i-1]]
+        if list(ints(prefix + ".rlcp")) != [v for i in rows for v in (i, lcp[i])]:
+            sys.exit("run-sampled LCP mismatch")
+    if os.path.exists(prefix + ".thr"):
+        bwt = open(prefix + ".bwt", "rb").read()
+        thr, last = [], {}
+        for i in range(len(bwt)):
+            if not i or bwt[i] != bwt[i-1]:
+                j = last.get(bwt[i])
+                # first row of the min LCP after the previous run of the char
+                thr.append(0 if j is None else min(range(j+1, i+1), key=lambda k: lcp[k]))
+            last[bwt[i]] = i
+        if list(ints(prefix + ".thr")) != thr:
+            sys.exit("thresholds mismatch")
+
+
+if __name__ == "__main__":
+    main()
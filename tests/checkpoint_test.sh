@@ -0,0 +1,75 @@
+#!/bin/bash
+# builds the BWT (and SAs, LCP, ...) of a test fasta w/ checkpoints every
+# 5000 rows, has pfbwt-f64 exit right after its second BWT checkpoint
+# (PFBWT_TEST_CKPT_EXIT), finishes it w/ --resume and checks the outputs
+# against an uninterrupted run, and that the checkpoints are gone. Then checks
+# that resuming w/ another BWT format (--rlbwt toggled) starts over. Options
+# after the test name are passed to every run (e.g. --lcp, --packed-bwt)
+if [[ -z ${1} ]]
+then
+    echo "no dir passed"
+    exit 1
+fi
+SOURCE=${1}
+
+if [[ ! -f ${SOURCE}/tests/data/${2}.fa ]];
+then
+    echo "${SOURCE}/tests/data/${2}.fa does not exist"
+    exit 1
+fi
+TEST=${2}
+shift 2
+NAME=${TEST}.ckpt$(echo "$@" | tr -d ' ')
+OPTS="-s -r -w 10 -p 10 $@"
+
+mkdir -p out
+./pfbwt-f64 ${OPTS} -o out/${NAME}.default ${SOURCE}/tests/data/${TEST}.fa 2> out/${NAME}.default.log || { echo "pfbwt-f64 failed"; exit 1; }
+PFBWT_TEST_CKPT_EXIT=2 ./pfbwt-f64 ${OPTS} --checkpoint 0.005 -o out/${NAME} ${SOURCE}/tests/data/${TEST}.fa 2> out/${NAME}.log
+[[ $? -eq 3 && -f out/${NAME}.bwt.ckpt ]] || { echo "pfbwt-f64 did not stop after a BWT checkpoint"; exit 1; }
+./pfbwt-f64 ${OPTS} --checkpoint 0.005 --resume -o out/${NAME} ${SOURCE}/tests/data/${TEST}.fa 2>> out/${NAME}.log || { echo "pfbwt-f64 --resume failed"; exit 1; }
+grep -q "resuming BWT from position [1-9]" out/${NAME}.log || { echo "BWT was not resumed from its checkpoint"; exit 1; }
+for ext in bwt.ckpt gsa.ckpt gsa glcp
+do
+    [[ ! -f out/${NAME}.${ext} ]] || { echo "${ext} left behind"; exit 1; }
+done
+for ext in bwt sa ssa esa lcp rlcp thr da sda eda smpsa smpsa.bv smpisa bwt.heads bwt.len bwt.2bit bwt.exc
+do
+    if [[ -f out/${NAME}.default.${ext} ]]
+    then
+        cmp -s out/${NAME}.${ext} out/${NAME}.default.${ext} || { echo "${ext} differs after resuming"; exit 1; }
+    fi
+done
+
+# writes the BWT of an output prefix to <prefix>.plain.bwt, expanded from
+# --rlbwt or --packed-bwt if needed
+plain_bwt() {
+    if [[ -f ${1}.bwt.heads ]]
+    then
+        python3 ${SOURCE}/scripts/rlbwt_to_bwt.py ${1} > ${1}.plain.bwt
+    elif [[ -f ${1}.bwt.2bit ]]
+    then
+        python3 ${SOURCE}/scripts/packed_bwt_to_bwt.py ${1} > ${1}.plain.bwt
+    else
+        cp ${1}.bwt ${1}.plain.bwt
+    fi
+}
+# a checkpoint of another BWT format must not be resumed from
+if [[ " $@ " == *" --rlbwt "* ]]
+then
+    SWITCHED="${OPTS/--rlbwt/}"
+elif [[ " $@ " == *" --packed-bwt "* ]]
+then
+    SWITCHED="${OPTS/--packed-bwt/--rlbwt}"
+else
+    SWITCHED="${OPTS} --rlbwt"
+fi
+PFBWT_TEST_CKPT_EXIT=2 ./pfbwt-f64 ${OPTS} --checkpoint 0.005 -o out/${NAME}.switch ${SOURCE}/tests/data/${TEST}.fa 2> out/${NAME}.switch.log
+[[ $? -eq 3 ]] || { echo "pfbwt-f64 did not stop after a BWT checkpoint"; exit 1; }
+# the partial BWT of the first format would be mistaken for the final one
+rm -f out/${NAME}.switch.bwt out/${NAME}.switch.bwt.heads out/${NAME}.switch.bwt.len out/${NAME}.switch.bwt.2bit out/${NAME}.switch.bwt.exc
+./pfbwt-f64 ${SWITCHED} --checkpoint 0.005 --resume -o out/${NAME}.switch ${SOURCE}/tests/data/${TEST}.fa 2>> out/${NAME}.switch.log || { echo "pfbwt-f64 --resume w/ another BWT format failed"; exit 1; }
+grep -q "no usable BWT checkpoint" out/${NAME}.switch.log || { echo "BWT checkpoint of another format was used"; exit 1; }
+plain_bwt out/${NAME}.default
+plain_bwt out/${NAME}.switch
+cmp -s out/${NAME}.switch.plain.bwt out/${NAME}.default.plain.bwt || { echo "bwt differs after switching formats"; exit 1; }
+exit 0
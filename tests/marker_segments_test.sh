@@ -0,0 +1,61 @@
+#!/bin/bash
+# builds the SA of a test fasta whole and split into segments (--segment-size),
+# writes synthetic marker positions (.mps) for its text, and checks that the
+# marker array segments of mps_to_ma -t (one per SA segment) give the same
+# markers per row as the marker array of the whole SA. Options after the test
+# name are passed to pfbwt-f64 and mps_to_ma (e.g. --packed-sa)
+if [[ -z ${1} ]]
+then
+    echo "no dir passed"
+    exit 1
+fi
+SOURCE=${1}
+
+if [[ ! -f ${SOURCE}/tests/data/${2}.fa ]];
+then
+    echo "${SOURCE}/tests/data/${2}.fa does not exist"
+    exit 1
+fi
+TEST=${2}
+shift 2
+OPTS="$@"
+NAME=${TEST}.maseg$(echo "${OPTS}" | tr -d ' ')
+
+mkdir -p out
+./pfbwt-f64 -s -w 10 -p 10 ${OPTS} -o out/${NAME} ${SOURCE}/tests/data/${TEST}.fa 2> out/${NAME}.log || { echo "pfbwt-f64 failed"; exit 1; }
+./pfbwt-f64 -s -w 10 -p 10 ${OPTS} --segment-size 0.01 -o out/${NAME}.seg ${SOURCE}/tests/data/${TEST}.fa 2>> out/${NAME}.log || { echo "pfbwt-f64 --segment-size failed"; exit 1; }
+[[ ! -f out/${NAME}.seg.sa && $(wc -l < out/${NAME}.seg.sa.segs) -gt 1 ]] || { echo "SA was not segmented"; exit 1; }
+# one marker per record: [start, end] of text positions, marker, delimiter
+python3 - $(cat out/${NAME}.n) out/${NAME}.mps <<'PYEOF' || { echo "could not write markers"; exit 1; }
+import sys, random, struct
+random.seed(0)
+n, out = int(sys.argv[1]), open(sys.argv[2], "wb")
+p = 5 # rle_window_arr does not take a record at 0
+while p < n:
+    e = min(n - 1, p + random.randrange(20))
+    m = (random.randrange(2) << 60) | random.randrange(1 << 20)
+    out.write(struct.pack("<4Q", p, e, m, 2**64 - 1))
+    p = e + 1 + random.randrange(10)
+PYEOF
+./mps_to_ma ${OPTS} -o out/${NAME}.ma out/${NAME}.mps out/${NAME}.sa 2>> out/${NAME}.log || { echo "mps_to_ma failed"; exit 1; }
+./mps_to_ma ${OPTS} -t 3 -o out/${NAME}.seg.ma out/${NAME}.mps out/${NAME}.seg.sa 2>> out/${NAME}.log || { echo "mps_to_ma -t on segments failed"; exit 1; }
+[[ $(wc -l < out/${NAME}.seg.ma.segs) -eq $(wc -l < out/${NAME}.seg.sa.segs) ]] || { echo "not one marker array segment per SA segment"; exit 1; }
+python3 - out/${NAME}.ma out/${NAME}.seg.ma.segs <<'PYEOF' || { echo "segmented marker array mismatch"; exit 1; }
+import sys, struct
+def rows(b):
+    # markers of each row, from [first row, last row, markers..., delimiter] records
+    v = struct.unpack("<{}Q".format(len(b) // 8), b)
+    r, i = {}, 0
+    while i < len(v):
+        j = v.index(2**64 - 1, i)
+        for k in range(v[i], v[i+1] + 1):
+            if k in r: sys.exit(1)
+            r[k] = v[i+2:j]
+        i = j + 1
+    return r
+segs = b"".join(open("out/" + l.split("\t")[0], "rb").read() for l in open(sys.argv[2]))
+whole = rows(open(sys.argv[1], "rb").read())
+if not whole or rows(segs) != whole:
+    sys.exit(1)
+PYEOF
+exit 0
@@ -0,0 +1,48 @@
+#!/bin/bash
+# parses each record of a test fasta on its own, joins the parses w/
+# merge_pfp --parse-bwt, builds the BWT, SA and LCP from the merged parse
+# (pfbwt-f64 --pfbwt-only) and compares them against a run on the whole fasta.
+# Options after TEST are passed to merge_pfp (e.g. --lcp). W/ --checkpoint,
+# also checks that merge_pfp --resume notices a re-parsed input
+if [[ -z ${1} ]]
+then
+    echo "no dir passed"
+    exit 1
+fi
+SOURCE=${1}
+
+if [[ ! -f ${SOURCE}/tests/data/${2}.fa ]];
+then
+    echo "${SOURCE}/tests/data/${2}.fa does not exist"
+    exit 1
+fi
+TEST=${2}
+shift 2
+NAME=${TEST}.merge$(echo "$@" | tr -d ' ')
+OPTS="-s --lcp -w 10 -p 10"
+
+mkdir -p out
+./pfbwt-f64 ${OPTS} -o out/${NAME}.full ${SOURCE}/tests/data/${TEST}.fa 2> out/${NAME}.log || { echo "pfbwt-f64 failed"; exit 1; }
+awk -v pre=out/${NAME}.part '/^>/ { f = pre (++n) ".fa" } { print > f }' ${SOURCE}/tests/data/${TEST}.fa
+parts=()
+for fa in out/${NAME}.part*.fa
+do
+    ./pfbwt-f64 ${OPTS} --parse-only -o ${fa%.fa} ${fa} 2>> out/${NAME}.log || { echo "pfbwt-f64 --parse-only ${fa} failed"; exit 1; }
+    parts+=(${fa%.fa})
+done
+./merge_pfp --parse-bwt -s -w 10 -p 10 $@ -o out/${NAME} ${parts[@]} 2>> out/${NAME}.log || { echo "merge_pfp failed"; exit 1; }
+# w/ --checkpoint, a rerun resumes unless an input was parsed again since
+if [[ " $@ " == *" --checkpoint "* ]]
+then
+    ./merge_pfp --parse-bwt -s -w 10 -p 10 $@ --resume -o out/${NAME} ${parts[@]} 2> out/${NAME}.resume.log || { echo "merge_pfp --resume failed"; exit 1; }
+    grep -q "resuming from merge checkpoint" out/${NAME}.resume.log || { echo "merge_pfp did not resume"; exit 1; }
+    ./pfbwt-f64 ${OPTS} --parse-only -o ${parts[0]} ${parts[0]}.fa 2>> out/${NAME}.log || { echo "pfbwt-f64 --parse-only ${parts[0]}.fa failed"; exit 1; }
+    ./merge_pfp --parse-bwt -s -w 10 -p 10 $@ --resume -o out/${NAME} ${parts[@]} 2> out/${NAME}.resume.log || { echo "merge_pfp --resume failed"; exit 1; }
+    ! grep -q "resuming from merge checkpoint" out/${NAME}.resume.log || { echo "merge_pfp resumed w/ a re-parsed input"; exit 1; }
+fi
+./pfbwt-f64 ${OPTS} --pfbwt-only -o out/${NAME} 2>> out/${NAME}.log || { echo "pfbwt-f64 --pfbwt-only failed"; exit 1; }
+for ext in bwt sa lcp
+do
+    cmp -s out/${NAME}.${ext} out/${NAME}.full.${ext} || { echo "${ext} differs from the unmerged run"; exit 1; }
+done
+exit 0
@@ -0,0 +1,121 @@
+#!/bin/bash
+# builds the BWT (and SAs) of a test fasta w/ default options and with the
+# options passed after the test name, and checks that the outputs agree
+if [[ -z ${1} ]]
+then
+    echo "no dir passed"
+    exit 1
+fi
+SOURCE=${1}
+
+if [[ -z ${2} ]]
+then
+    echo "no test passed"
+    exit 1
+fi
+
+if [[ ! -f ${SOURCE}/tests/data/${2}.fa ]];
+then
+    echo "${SOURCE}/tests/data/${2}.fa does not exist"
+    exit 1
+fi
+TEST=${2}
+shift 2
+OPTS="$@"
+NAME=${TEST}.modes$(echo "${OPTS}" | tr -d ' ')
+PFBWTF=./pfbwt-f64
+
+mkdir -p out
+${PFBWTF} -s -r -w 10 -p 10 -o out/${NAME}.default ${SOURCE}/tests/data/${TEST}.fa 2> out/${NAME}.default.log || { echo "pfbwt-f64 failed"; exit 1; }
+${PFBWTF} -s -r -w 10 -p 10 ${OPTS} -o out/${NAME} ${SOURCE}/tests/data/${TEST}.fa 2> out/${NAME}.log || { echo "pfbwt-f64 ${OPTS} failed"; exit 1; }
+
+# --segment-size splits .bwt and .sa into segments listed in .segs files
+for ext in bwt sa
+do
+    if [[ -f out/${NAME}.${ext}.segs ]]
+    then
+        (cd out && cat $(cut -f1 ${NAME}.${ext}.segs)) > out/${NAME}.${ext} || { echo "could not join ${ext} segments"; exit 1; }
+    fi
+done
+
+# --packed-sa writes 5-byte SA values, widened here to compare w/ the default
+if [[ " ${OPTS} " == *" --packed-sa "* ]]
+then
+    mv out/${NAME}.sa out/${NAME}.sa.packed
+    python3 -c 'import sys; b = open(sys.argv[1], "rb").read(); sys.stdout.buffer.write(b"".join(b[i:i+5] + bytes(3) for i in range(0, len(b), 5)))' \
+        out/${NAME}.sa.packed > out/${NAME}.sa || { echo "could not widen packed SA"; exit 1; }
+fi
+
+# --rlbwt writes .bwt.heads and .bwt.len instead of .bwt
+if [[ -f out/${NAME}.bwt.heads ]]
+then
+    python3 ${SOURCE}/scripts/rlbwt_to_bwt.py out/${NAME} > out/${NAME}.bwt || { echo "could not expand RLBWT"; exit 1; }
+fi
+
+# --packed-bwt writes .bwt.2bit and .bwt.exc instead of .bwt
+if [[ -f out/${NAME}.bwt.2bit ]]
+then
+    python3 ${SOURCE}/scripts/packed_bwt_to_bwt.py out/${NAME} > out/${NAME}.bwt || { echo "could not expand packed BWT"; exit 1; }
+fi
+
+# --phi writes phi and inverse phi, checked against the full SA
+if [[ -f out/${NAME}.phi ]]
+then
+    ./build_phi -c out/${NAME} || { echo "phi mismatch"; exit 1; }
+fi
+
+# --da/--rlda write the doc of each SA entry (or of each run start/end)
+if [[ -f out/${NAME}.da || -f out/${NAME}.sda ]]
+then
+    python3 - out/${NAME} <<'PYEOF' || { echo "document array mismatch"; exit 1; }
+import sys, os, struct, bisect
+prefix = sys.argv[1]
+def ints(ext, fmt):
+    b = open(prefix + "." + ext, "rb").read()
+    return struct.unpack("<{}{}".format(len(b) // struct.calcsize(fmt), fmt), b)
+starts = [int(l.split()[-1]) for l in open(prefix + ".docs")]
+docs = [bisect.bisect_right(starts, x) - 1 for x in ints("sa", "Q")]
+if os.path.exists(prefix + ".da") and list(ints("da", "I")) != docs:
+    sys.exit(1)
+for s, d in (("ssa", "sda"), ("esa", "eda")):
+    if os.path.exists(prefix + "." + d):
+        rows = ints(s, "Q")[::2]
+        if list(ints(d, "Q")) != [v for i in rows for v in (i, docs[i])]:
+            sys.exit(1)
+PYEOF
+fi
+
+# --lcp (and --rlcp, --thresholds) are checked against the SA
+if [[ -f out/${NAME}.lcp ]]
+then
+    python3 ${SOURCE}/tests/check_lcp.py ${SOURCE}/tests/data/${TEST}.fa out/${NAME} 10 || { echo "LCP mismatch"; exit 1; }
+fi
+
+# --sa-sample-rate writes SA samples, their rows and ISA samples
+if [[ -f out/${NAME}.smpsa ]]
+then
+    python3 - out/${NAME} ${OPTS} <<'PYEOF' || { echo "sampled SA mismatch"; exit 1; }
+import sys, struct
+prefix, opts = sys.argv[1], sys.argv[2:]
+k = int(opts[opts.index("--sa-sample-rate") + 1])
+def ints(ext):
+    b = open(prefix + "." + ext, "rb").read()
+    return struct.unpack("<{}Q".format(len(b) // 8), b)
+sa = ints("sa")
+rows = [i for i in range(len(sa)) if sa[i] % k == 0]
+bv = ints("smpsa.bv")
+marked = [i for i in range(bv[0]) if bv[1 + i // 64] >> (i % 64) & 1]
+isa = [0] * ((len(sa) - 1) // k + 1)
+for i in rows:
+    isa[sa[i] // k] = i
+if bv[0] != len(sa) or len(bv) != 1 + (len(sa) + 63) // 64 or marked != rows \
+        or list(ints("smpsa")) != [sa[i] for i in rows] or list(ints("smpisa")) != isa:
+    sys.exit(1)
+PYEOF
+fi
+
+for ext in bwt sa ssa esa
+do
+    cmp -s out/${NAME}.${ext} out/${NAME}.default.${ext} || { echo "${ext} mismatch"; exit 1; }
+done
+exit 0
@@ -0,0 +1,58 @@
+#!/bin/bash
+# builds the RLBWT and SAs of a test fasta, and checks pfbwt-query's counts and
+# locations (w/ the full SA, and w/ the run-sampled SA and phi, from a packed
+# BWT, and from a BWT and SA split into segments) against a naive search of
+# the text
+if [[ -z ${1} ]]
+then
+    echo "no dir passed"
+    exit 1
+fi
+SOURCE=${1}
+
+if [[ ! -f ${SOURCE}/tests/data/${2}.fa ]];
+then
+    echo "${SOURCE}/tests/data/${2}.fa does not exist"
+    exit 1
+fi
+TEST=${2}
+NAME=${TEST}.query
+
+mkdir -p out
+./pfbwt-f64 -s -r --rlbwt -w 10 -p 10 -o out/${NAME} ${SOURCE}/tests/data/${TEST}.fa 2> out/${NAME}.log || { echo "pfbwt-f64 failed"; exit 1; }
+python3 - ${SOURCE}/tests/data/${TEST}.fa out/${NAME} <<'PYEOF' || { echo "could not make queries"; exit 1; }
+import sys, random
+random.seed(0)
+seqs = []
+for line in open(sys.argv[1]):
+    if line[0] == '>':
+        seqs.append([])
+    else:
+        seqs[-1].append(line.strip().upper())
+t = "".join("".join(s) + "A" * 10 for s in seqs) # text as parsed w/ -w 10
+with open(sys.argv[2] + ".queries.fq", "w") as q, open(sys.argv[2] + ".expected", "w") as e:
+    for i in range(200):
+        l = random.choice([1, 4, 10, 25, 60])
+        if i % 4:
+            s = random.randrange(len(t) - l)
+            p = t[s:s+l]
+        else:
+            p = "".join(random.choice("ACGT") for _ in range(l))
+        q.write("@q{}\n{}\n+\n{}\n".format(i, p.lower() if i % 3 == 0 else p, "I" * l))
+        locs = [j for j in range(len(t) - l + 1) if t.startswith(p, j)]
+        e.write("q{}\t{}\t{}\t{}\n".format(i, l, len(locs), ",".join(map(str, locs))))
+PYEOF
+./pfbwt-query -l -t 3 -b 17 out/${NAME} out/${NAME}.queries.fq > out/${NAME}.sa.tsv 2>> out/${NAME}.log || { echo "pfbwt-query failed"; exit 1; }
+cmp -s out/${NAME}.sa.tsv out/${NAME}.expected || { echo "full SA results mismatch"; exit 1; }
+./pfbwt-query -l -r -t 3 -b 17 out/${NAME} out/${NAME}.queries.fq > out/${NAME}.rs.tsv 2>> out/${NAME}.log || { echo "pfbwt-query -r failed"; exit 1; }
+cmp -s out/${NAME}.rs.tsv out/${NAME}.expected || { echo "run-sampled SA results mismatch"; exit 1; }
+# and from the 2-bit packed BWT
+./pfbwt-f64 -s --packed-bwt -w 10 -p 10 -o out/${NAME}.packed ${SOURCE}/tests/data/${TEST}.fa 2>> out/${NAME}.log || { echo "pfbwt-f64 --packed-bwt failed"; exit 1; }
+./pfbwt-query -l out/${NAME}.packed out/${NAME}.queries.fq > out/${NAME}.packed.tsv 2>> out/${NAME}.log || { echo "pfbwt-query on packed BWT failed"; exit 1; }
+cmp -s out/${NAME}.packed.tsv out/${NAME}.expected || { echo "packed BWT results mismatch"; exit 1; }
+# and from a plain BWT and (packed) SA split into segments
+./pfbwt-f64 -s --packed-sa --segment-size 0.01 -w 10 -p 10 -o out/${NAME}.seg ${SOURCE}/tests/data/${TEST}.fa 2>> out/${NAME}.log || { echo "pfbwt-f64 --segment-size failed"; exit 1; }
+[[ ! -f out/${NAME}.seg.sa && $(wc -l < out/${NAME}.seg.sa.segs) -gt 1 ]] || { echo "SA was not segmented"; exit 1; }
+./pfbwt-query -l -t 3 out/${NAME}.seg out/${NAME}.queries.fq > out/${NAME}.seg.tsv 2>> out/${NAME}.log || { echo "pfbwt-query on segments failed"; exit 1; }
+cmp -s out/${NAME}.seg.tsv out/${NAME}.expected || { echo "segmented BWT/SA results mismatch"; exit 1; }
+exit 0
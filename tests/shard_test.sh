@@ -0,0 +1,42 @@
+#!/bin/bash
+# builds the BWT, SA, run-sampled SA, DA and LCP of a test fasta in N shards
+# (pfbwt-f64 --shard), all running at once, joins them w/ merge_shards.py and
+# compares the result against an unsharded run. Options after N are passed to
+# every run (e.g. -m, --ext-gsa)
+if [[ -z ${1} ]]
+then
+    echo "no dir passed"
+    exit 1
+fi
+SOURCE=${1}
+
+if [[ ! -f ${SOURCE}/tests/data/${2}.fa ]];
+then
+    echo "${SOURCE}/tests/data/${2}.fa does not exist"
+    exit 1
+fi
+TEST=${2}
+N=${3:-3}
+shift 3
+NAME=${TEST}.shard${N}$(echo "$@" | tr -d ' ')
+OPTS="-s -r --da --lcp -w 10 -p 10 $@"
+
+mkdir -p out
+./pfbwt-f64 ${OPTS} -o out/${NAME}.full ${SOURCE}/tests/data/${TEST}.fa 2> out/${NAME}.log || { echo "pfbwt-f64 failed"; exit 1; }
+./pfbwt-f64 ${OPTS} --parse-only -o out/${NAME} ${SOURCE}/tests/data/${TEST}.fa 2>> out/${NAME}.log || { echo "pfbwt-f64 --parse-only failed"; exit 1; }
+pids=()
+for ((i = 0; i < N; ++i))
+do
+    ./pfbwt-f64 ${OPTS} --pfbwt-only --shard ${i}/${N} -o out/${NAME} 2> out/${NAME}.shard${i}.log &
+    pids+=($!)
+done
+for ((i = 0; i < N; ++i))
+do
+    wait ${pids[$i]} || { echo "shard ${i}/${N} failed"; exit 1; }
+done
+python3 ${SOURCE}/scripts/merge_shards.py --remove out/${NAME} ${N} >> out/${NAME}.log || { echo "merge_shards.py failed"; exit 1; }
+for ext in bwt sa ssa esa da lcp
+do
+    cmp -s out/${NAME}.${ext} out/${NAME}.full.${ext} || { echo "${ext} differs from the unsharded run"; exit 1; }
+done
+exit 0
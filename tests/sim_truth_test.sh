@@ -0,0 +1,18 @@
+#!/bin/bash
+# simulates a small pangenome w/ its true BWT and SA, and checks that
+# pfbwt-f64 reproduces them. options after the dir are passed to pfbwt-f64
+if [[ -z ${1} ]]
+then
+    echo "no dir passed"
+    exit 1
+fi
+shift 1
+OPTS="$@"
+NAME=sim$(echo "${OPTS}" | tr -d ' ')
+
+mkdir -p out
+./sim_pangenome -o out/${NAME} -c 2 -l 20000 -H 5 -d 0.01 -i 0.002 --n-frac 0.05 --n-run-len 50 --truth 2> out/${NAME}.sim.log || { echo "sim_pangenome failed"; exit 1; }
+./pfbwt-f64 -s -w 10 -p 20 ${OPTS} -o out/${NAME} out/${NAME}.fa 2> out/${NAME}.log || { echo "pfbwt-f64 ${OPTS} failed"; exit 1; }
+cmp -s out/${NAME}.bwt out/${NAME}.truth.bwt || { echo "BWT mismatch"; exit 1; }
+cmp -s out/${NAME}.sa out/${NAME}.truth.sa || { echo "SA mismatch"; exit 1; }
+exit 0
@@ -174,6 +174,8 @@ class PfbwtCmd:
         cmd = [PFBWTF_EXE, '--pfbwt-only', '--print-docs', '-o', self.o, '-w', self.wsize, '-m', self.mod]
         if self.sa or self.ma:
             cmd += ['--stdout', 'sa', '-s']
+        if self.ma and not self.sa:
+            cmd += ['--packed-sa'] # only piped to mps_to_ma, so 5 bytes per value is enough
         if self.mmap:
             cmd += ['-m']
         if self.rssa:
@@ -266,7 +268,7 @@ def vcf_to_bwt(args):
         sa_fp.close()
     elif args.ma and not args.sa:
         logger.info("constructing marker array along with BWT. SA will not be saved")
-        marker_array_cmd = [MPS_TO_MA_EXE, "-o", args.o + ".ma", args.o + ".mps", '-']
+        marker_array_cmd = [MPS_TO_MA_EXE, '--packed-sa', "-o", args.o + ".ma", args.o + ".mps", '-']
         if args.mmap:
             marker_array_cmd = marker_array_cmd[:1] + ['-m'] + marker_array_cmd[1:]
         logger.info(" ".join(pfbwt_cmd) + " | " + " ".join(marker_array_cmd))